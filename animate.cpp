@@ -1,11 +1,19 @@
 #include "animate.hpp"
 
+#include <algorithm>
+#include <charconv>
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <sstream>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <vector>
 
+#include <cctype>
 #include <cerrno>
 #include <cstdio>
 #include <cstring>
@@ -34,9 +42,13 @@
 #define ALT_BUFF CSI "?1049"
 #define CURSOR CSI "?25"
 #define CLS CSI "2J"
+#define CLEAR_LINE CSI "2K"
 #define SEP ";"
 #define CUP "H"
 #define RESET_CHAR CSI "0" SGR
+#define SYNC_UPDATE CSI "?2026"
+#define DECRQM "$p"
+#define DA1 CSI "c"
 
 class Animate::Animate_impl
 {
@@ -49,6 +61,8 @@ public:
     Animate_impl & operator=(Animate_impl &&) = delete;
 
     void display(const Image & img);
+    void play(const Image & img);
+    void slideshow(std::size_t num_slides, const std::function<Slide(std::size_t)> & get_slide, std::chrono::duration<float> interval);
     void set_frame_delay(std::chrono::duration<float> delay_s);
 
     bool running() const;
@@ -61,12 +75,43 @@ private:
     termios old_term_info_;
 #endif
     bool running_ {true};
+    bool keyboard_ {false}; // reading keyboard controls from stdin
+    bool paused_ {false};
+    std::string seek_input_; // frame number / time typed so far
+    std::optional<bool> sync_update_supported_;
+    std::ostringstream frame_buffer_;
+    Frame_display frame_display_;
+
+    // progressively lower quality settings, used when the terminal can't keep up
+    struct Quality_level
+    {
+        Args::Color color;
+        Args::Disp_char disp_char;
+        float scale;
+    };
+    std::vector<Quality_level> quality_levels_;
+    std::size_t quality_level_ {0};
+    Args display_args_;
+    float write_load_ {0.0f}; // running average of frame write time / frame delay
+    unsigned int frames_since_quality_change_ {0};
+    bool clear_screen_ {false};
 
     void open_alternate_buffer();
     void close_alternate_buffer();
     void set_signals();
     void reset_signals();
-    void reset_cursor_pos() const;
+    void reset_cursor_pos(std::ostream & out) const;
+    void show_frame(const Image & img, bool follows_previous);
+    bool handle_signals();
+    std::chrono::duration<float> get_frame_delay(const Image & img, std::size_t frame_no) const;
+    std::optional<std::size_t> wait_for_next_frame(std::size_t frame_no, const std::vector<std::chrono::duration<float>> & frame_times);
+    std::optional<std::size_t> wait_for_next_slide(std::size_t slide_no, std::size_t num_slides, std::chrono::duration<float> interval, bool shown);
+    std::optional<std::string> read_key(std::optional<std::chrono::duration<float>> timeout);
+    bool query_sync_update_support() const;
+    void write_frame(std::string_view frame) const;
+    void build_quality_levels();
+    void update_display_args(const Image & img);
+    void adjust_quality(std::chrono::duration<float> write_time);
 };
 
 namespace
@@ -119,6 +164,19 @@ namespace
         signal(sig, SIG_DFL);
     #endif
     }
+
+    // adaptive quality thresholds, as the fraction of the frame delay spent writing a frame
+    constexpr float write_load_high = 0.5f;
+    constexpr float write_load_low  = 0.1f;
+    constexpr float write_load_smoothing = 0.25f;
+    // frames to measure before changing quality. Quick to step down, slow to step back up
+    constexpr unsigned int quality_step_down_frames = 3u;
+    constexpr unsigned int quality_step_up_frames = 30u;
+
+    // how often a slideshow checks whether the slide shown needs redrawing
+    constexpr auto slide_refresh_interval = std::chrono::duration<float>{0.25f};
+    // how often a slideshow checks whether a slide it's waiting for is ready
+    constexpr auto slide_load_poll_interval = std::chrono::duration<float>{0.02f};
 }
 
 Animate::Animate(const Args & args):
@@ -126,13 +184,15 @@ Animate::Animate(const Args & args):
 {}
 Animate::Animate_impl::Animate_impl(const Args & args):
     args_{args},
-    frame_delay_{args.animation_frame_delay > 0.0f ? args.animation_frame_delay : 1.0f / 30.0f}
+    frame_delay_{args.animation_frame_delay > 0.0f ? args.animation_frame_delay : 1.0f / 30.0f},
+    display_args_{args}
 {
 #ifdef HAS_UNISTD
     if(!isatty(fileno(stdout)))
         throw std::runtime_error{"Can't animate - not a TTY"};
 #endif
 
+    build_quality_levels();
     set_signals();
     open_alternate_buffer();
 }
@@ -147,10 +207,172 @@ Animate::Animate_impl::~Animate_impl()
 void Animate::display(const Image & img) { pimpl->display(img); }
 void Animate::Animate_impl::display(const Image & img)
 {
-    reset_cursor_pos();
-    print_image(img, args_, std::cout);
-    std::cout.flush();
+    show_frame(img, true);
+    if(!running_)
+        return;
+
+    auto frame_end = std::chrono::high_resolution_clock::now();
+    auto frame_time = std::max(decltype(frame_delay_)::zero(), std::chrono::duration_cast<decltype(frame_delay_)>(frame_end-last_frame_time_));
+    auto sleep_time = frame_delay_ - frame_time;
+
+    std::this_thread::sleep_for(sleep_time);
+    last_frame_time_ = std::chrono::high_resolution_clock::now();
+}
+
+// Play all frames of img, handling keyboard controls:
+//   space          pause / resume
+//   right, l, .    step forward (and pause)
+//   left, h, ,     step back (and pause)
+//   home, g        first frame
+//   end, G         last frame
+//   N g / N enter  go to frame N
+//   N t            go to N seconds in (N may have a decimal point)
+//   q              quit
+void Animate::play(const Image & img) { pimpl->play(img); }
+void Animate::Animate_impl::play(const Image & img)
+{
+    const auto num_frames = img.num_frames();
+    if(num_frames == 0)
+        return;
+
+    // start time of each frame, for seeking by time
+    auto frame_times = std::vector<std::chrono::duration<float>>(num_frames);
+    for(std::size_t f = 1; f < num_frames; ++f)
+        frame_times[f] = frame_times[f - 1] + get_frame_delay(img, f - 1);
+
+    std::size_t frame_no = 0;
+    bool follows_previous = true;
+    while(running_)
+    {
+        frame_delay_ = get_frame_delay(img, frame_no);
+        show_frame(img.get_frame(frame_no), follows_previous);
+        if(!running_)
+            break;
+
+        auto next_frame = wait_for_next_frame(frame_no, frame_times);
+        if(!next_frame)
+            break;
+
+        follows_previous = *next_frame == frame_no + 1;
+        frame_no = *next_frame;
+    }
+}
+
+// Show slides, handling keyboard controls:
+//   right, l, n, page down   next slide
+//   left, h, p, page up      previous slide
+//   home, g                  first slide
+//   end, G                   last slide
+//   N g / N enter            go to slide N (from 1)
+//   space                    pause / resume with an interval, otherwise next slide
+//   q                        quit
+// Moving past either end wraps around
+void Animate::slideshow(std::size_t num_slides, const std::function<Slide(std::size_t)> & get_slide, std::chrono::duration<float> interval)
+{
+    pimpl->slideshow(num_slides, get_slide, interval);
+}
+void Animate::Animate_impl::slideshow(std::size_t num_slides, const std::function<Slide(std::size_t)> & get_slide, std::chrono::duration<float> interval)
+{
+    if(num_slides == 0)
+        return;
+
+    std::size_t slide_no = 0;
+    last_frame_time_ = std::chrono::high_resolution_clock::now();
+    Slide shown;
+    auto loading_shown = num_slides; // slide the loading message is shown for, if any
+    while(running_)
+    {
+        auto slide = get_slide(slide_no);
+
+        // after being suspended, the screen needs redrawing, and the slide gets its full interval again
+        if(handle_signals())
+        {
+            shown.reset();
+            loading_shown = num_slides;
+            last_frame_time_ = std::chrono::high_resolution_clock::now();
+        }
+        if(!running_)
+            break;
+
+        if(!slide)
+        {
+            // the slide's interval starts once it's shown
+            last_frame_time_ = std::chrono::high_resolution_clock::now();
+
+            if(loading_shown != slide_no)
+            {
+                frame_buffer_.str("");
+                frame_buffer_ << '\r' << RESET_CHAR CLEAR_LINE << "Loading (" << slide_no + 1 << '/' << num_slides << ")...";
+                write_frame(frame_buffer_.view());
+                loading_shown = slide_no;
+
+                // the message covers part of the slide shown, so it's redrawn even if it comes back
+                shown.reset();
+            }
+        }
+        // slides differ in size, so each is drawn on a clear screen
+        else if(slide != shown)
+        {
+            frame_buffer_.str("");
+            if(sync_update_supported_.value_or(false))
+                frame_buffer_ << SYNC_UPDATE ENABLED;
+            frame_buffer_ << CLS;
+            reset_cursor_pos(frame_buffer_);
+            frame_buffer_ << *slide;
+            if(sync_update_supported_.value_or(false))
+                frame_buffer_ << SYNC_UPDATE DISABLED;
+
+            write_frame(frame_buffer_.view());
+            shown = slide;
+            loading_shown = num_slides;
+        }
+
+        auto next_slide = wait_for_next_slide(slide_no, num_slides, interval, static_cast<bool>(slide));
+        if(!next_slide)
+            break;
+
+        if(*next_slide != slide_no)
+        {
+            slide_no = *next_slide;
+            last_frame_time_ = std::chrono::high_resolution_clock::now();
+        }
+    }
+}
+
+void Animate::Animate_impl::show_frame(const Image & img, bool follows_previous)
+{
+    // build the whole frame up front so it can be submitted with a single write
+    frame_buffer_.str("");
+
+    if(sync_update_supported_.value_or(false))
+        frame_buffer_ << SYNC_UPDATE ENABLED;
+
+    // a lower quality frame may not cover everything the previous frame did
+    if(clear_screen_)
+    {
+        frame_buffer_ << CLS;
+        frame_display_.invalidate();
+        clear_screen_ = false;
+    }
+
+    update_display_args(img);
+    reset_cursor_pos(frame_buffer_);
+    frame_display_.print(img, display_args_, frame_buffer_, follows_previous);
 
+    if(sync_update_supported_.value_or(false))
+        frame_buffer_ << SYNC_UPDATE DISABLED;
+
+    auto write_start = std::chrono::high_resolution_clock::now();
+    write_frame(frame_buffer_.view());
+    adjust_quality(std::chrono::high_resolution_clock::now() - write_start);
+
+    handle_signals();
+}
+
+// returns true if we were suspended, and the screen needs to be redrawn
+bool Animate::Animate_impl::handle_signals()
+{
+    bool suspended = false;
 #if defined(HAS_SELECT) && defined(HAS_SIGNAL)
     if(suspend_flag)
     {
@@ -162,21 +384,275 @@ void Animate::Animate_impl::display(const Image & img)
         open_alternate_buffer();
         suspend_flag = 0;
         last_frame_time_ = decltype(last_frame_time_)::min();
+        suspended = true;
     }
 
     if(stop_flag)
+        running_ = false;
+#endif
+    return suspended;
+}
+
+std::chrono::duration<float> Animate::Animate_impl::get_frame_delay(const Image & img, std::size_t frame_no) const
+{
+    return args_.animation_frame_delay > 0.0f ? std::chrono::duration<float>(args_.animation_frame_delay) : img.get_frame_delay(frame_no);
+}
+
+// wait until the current frame's delay is up, or for a key that moves to another frame
+std::optional<std::size_t> Animate::Animate_impl::wait_for_next_frame(std::size_t frame_no, const std::vector<std::chrono::duration<float>> & frame_times)
+{
+    const auto num_frames = std::size(frame_times);
+    const auto deadline = last_frame_time_ + frame_delay_;
+
+    auto following_frame = [this, frame_no, num_frames]() -> std::optional<std::size_t>
+    {
+        if(frame_no + 1 < num_frames)
+            return frame_no + 1;
+        else if(args_.loop_animation)
+            return 0;
+        else
+            return std::nullopt;
+    };
+
+    while(true)
+    {
+        if(handle_signals())
+            return frame_no;
+        if(!running_)
+            return std::nullopt;
+
+        // still check for keys when we're already late for the next frame
+        std::optional<std::chrono::duration<float>> timeout;
+        if(!paused_)
+            timeout = std::max(std::chrono::duration<float>::zero(), std::chrono::duration<float>{deadline - std::chrono::high_resolution_clock::now()});
+
+        std::optional<std::string> key;
+        if(keyboard_)
+            key = read_key(timeout);
+        else
+            std::this_thread::sleep_for(timeout.value_or(frame_delay_));
+
+        if(!key)
+        {
+            if(auto now = std::chrono::high_resolution_clock::now(); !paused_ && now >= deadline)
+            {
+                last_frame_time_ = now;
+                return following_frame();
+            }
+            continue;
+        }
+
+        if(*key == " ")
+        {
+            paused_ = !paused_;
+            if(!paused_)
+            {
+                last_frame_time_ = std::chrono::high_resolution_clock::now();
+                return following_frame();
+            }
+        }
+        else if(*key == "q")
+        {
+            running_ = false;
+            return std::nullopt;
+        }
+        else if(std::size(*key) == 1 && (std::isdigit(static_cast<unsigned char>((*key)[0])) || ((*key)[0] == '.' && !std::empty(seek_input_))))
+        {
+            seek_input_ += *key;
+        }
+        else if(*key == CSI "C" || *key == "l" || *key == ".")
+        {
+            paused_ = true;
+            return following_frame().value_or(frame_no);
+        }
+        else if(*key == CSI "D" || *key == "h" || *key == ",")
+        {
+            paused_ = true;
+            if(frame_no > 0)
+                return frame_no - 1;
+            else
+                return args_.loop_animation ? num_frames - 1 : 0;
+        }
+        else if(*key == CSI "H" || *key == ESC "OH" || *key == CSI "1~" || (*key == "g" && std::empty(seek_input_)))
+        {
+            seek_input_.clear();
+            return 0;
+        }
+        else if(*key == CSI "F" || *key == ESC "OF" || *key == CSI "4~" || *key == "G")
+        {
+            seek_input_.clear();
+            return num_frames - 1;
+        }
+        else if(*key == "\x7F" || *key == "\b")
+        {
+            if(!std::empty(seek_input_))
+                seek_input_.pop_back();
+        }
+        else if(*key == "g" || *key == "\n" || *key == "\r")
+        {
+            std::size_t target = 0;
+            auto [ptr, ec] = std::from_chars(std::data(seek_input_), std::data(seek_input_) + std::size(seek_input_), target);
+            seek_input_.clear();
+            if(ec == std::errc{})
+                return std::min(target, num_frames - 1);
+        }
+        else if(*key == "t")
+        {
+            float seconds = 0.0f;
+            auto [ptr, ec] = std::from_chars(std::data(seek_input_), std::data(seek_input_) + std::size(seek_input_), seconds);
+            seek_input_.clear();
+            if(ec == std::errc{})
+            {
+                auto frame = std::upper_bound(std::begin(frame_times), std::end(frame_times), std::chrono::duration<float>{seconds});
+                return static_cast<std::size_t>(std::distance(std::begin(frame_times), frame)) - 1u;
+            }
+        }
+        else if(*key == ESC)
+        {
+            seek_input_.clear();
+        }
+    }
+}
+
+// wait until the slide's interval is up, or for a key that moves to another slide. Returns slide_no again after a
+// signal, or a while with neither, so the caller can check whether it needs redrawing. A slide that isn't shown yet
+// never times out, and is checked on more often, to show it as soon as it's ready
+std::optional<std::size_t> Animate::Animate_impl::wait_for_next_slide(std::size_t slide_no, std::size_t num_slides, std::chrono::duration<float> interval, bool shown)
+{
+    const auto advancing = interval > std::chrono::duration<float>::zero();
+    const auto next = (slide_no + 1) % num_slides;
+    const auto previous = (slide_no + num_slides - 1) % num_slides;
+
+    if(!running_)
+        return std::nullopt;
+
+    auto timeout = shown ? slide_refresh_interval : slide_load_poll_interval;
+    if(shown && advancing && !paused_)
+    {
+        auto remaining = interval - std::chrono::duration<float>{std::chrono::high_resolution_clock::now() - last_frame_time_};
+        if(remaining <= std::chrono::duration<float>::zero())
+            return next;
+        timeout = std::min(timeout, remaining);
+    }
+
+    std::optional<std::string> key;
+    if(keyboard_)
+        key = read_key(timeout);
+    else
+        std::this_thread::sleep_for(timeout);
+
+    if(!key)
+        return slide_no;
+
+    if(*key == "q")
     {
         running_ = false;
-        return;
+        return std::nullopt;
     }
-#endif
+    else if(*key == " ")
+    {
+        if(!advancing)
+            return next;
 
-    auto frame_end = std::chrono::high_resolution_clock::now();
-    auto frame_time = std::max(decltype(frame_delay_)::zero(), std::chrono::duration_cast<decltype(frame_delay_)>(frame_end-last_frame_time_));
-    auto sleep_time = frame_delay_ - frame_time;
+        // resuming gives the slide a full interval again
+        paused_ = !paused_;
+        last_frame_time_ = std::chrono::high_resolution_clock::now();
+    }
+    else if(std::size(*key) == 1 && std::isdigit(static_cast<unsigned char>((*key)[0])))
+    {
+        seek_input_ += *key;
+    }
+    else if(*key == CSI "C" || *key == "l" || *key == "n" || *key == CSI "6~")
+    {
+        seek_input_.clear();
+        return next;
+    }
+    else if(*key == CSI "D" || *key == "h" || *key == "p" || *key == CSI "5~")
+    {
+        seek_input_.clear();
+        return previous;
+    }
+    else if(*key == CSI "H" || *key == ESC "OH" || *key == CSI "1~" || (*key == "g" && std::empty(seek_input_)))
+    {
+        return 0;
+    }
+    else if(*key == CSI "F" || *key == ESC "OF" || *key == CSI "4~" || *key == "G")
+    {
+        seek_input_.clear();
+        return num_slides - 1;
+    }
+    else if(*key == "\x7F" || *key == "\b")
+    {
+        if(!std::empty(seek_input_))
+            seek_input_.pop_back();
+    }
+    else if(*key == "g" || *key == "\n" || *key == "\r")
+    {
+        std::size_t target = 0;
+        auto [ptr, ec] = std::from_chars(std::data(seek_input_), std::data(seek_input_) + std::size(seek_input_), target);
+        seek_input_.clear();
+        if(ec == std::errc{} && target > 0)
+            return std::min(target, num_slides) - 1;
+    }
+    else if(*key == ESC)
+    {
+        seek_input_.clear();
+    }
 
-    std::this_thread::sleep_for(sleep_time);
-    last_frame_time_ = std::chrono::high_resolution_clock::now();
+    return slide_no;
+}
+
+// read a key press, including any escape sequence it sends. Waits forever with no timeout.
+// Returns nothing on timeout or signal
+std::optional<std::string> Animate::Animate_impl::read_key(std::optional<std::chrono::duration<float>> timeout)
+{
+#if defined(HAS_TERMIOS) && defined(HAS_SELECT) && defined(HAS_UNISTD)
+    auto wait_for_input = [](timeval * tv)
+    {
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        FD_SET(STDIN_FILENO, &read_fds);
+        return select(STDIN_FILENO + 1, &read_fds, nullptr, nullptr, tv) > 0;
+    };
+
+    std::optional<timeval> tv;
+    if(timeout)
+    {
+        auto usec = std::chrono::duration_cast<std::chrono::microseconds>(*timeout).count();
+        tv = timeval{.tv_sec = static_cast<decltype(tv->tv_sec)>(usec / 1000000), .tv_usec = static_cast<decltype(tv->tv_usec)>(usec % 1000000)};
+    }
+
+    if(!wait_for_input(tv ? &*tv : nullptr))
+        return std::nullopt;
+
+    char c;
+    if(auto bytes = read(STDIN_FILENO, &c, 1); bytes != 1)
+    {
+        if(bytes == 0) // EOF - stop trying to read from stdin
+            keyboard_ = false;
+        return std::nullopt;
+    }
+
+    auto key = std::string{c};
+
+    // the rest of an escape sequence arrives along with the ESC
+    if(c == ESC[0])
+    {
+        auto no_wait = timeval{};
+        while(wait_for_input(&no_wait) && read(STDIN_FILENO, &c, 1) == 1)
+        {
+            key += c;
+            if(std::size(key) > 2 && (std::isalpha(static_cast<unsigned char>(c)) || c == '~'))
+                break;
+            no_wait = timeval{};
+        }
+    }
+
+    return key;
+#else
+    static_cast<void>(timeout);
+    return std::nullopt;
+#endif
 }
 
 void Animate::set_framerate(float fps) { pimpl->set_frame_delay(std::chrono::duration<float>(1.0f / fps)); }
@@ -189,6 +665,7 @@ bool Animate::Animate_impl::running() const { return running_; }
 void Animate::Animate_impl::open_alternate_buffer()
 {
     std::cout <<ALT_BUFF ENABLED CLS CURSOR DISABLED << std::flush;
+    frame_display_.invalidate();
 
 #ifdef HAS_TERMIOS
     tcgetattr(STDIN_FILENO, &old_term_info_); // save old term attrs
@@ -197,6 +674,14 @@ void Animate::Animate_impl::open_alternate_buffer()
     newt.c_lflag &= ~(ICANON | ECHO);
     tcsetattr(STDIN_FILENO, TCSANOW, &newt);
 #endif
+
+    if(!sync_update_supported_)
+        sync_update_supported_ = query_sync_update_support();
+
+#if defined(HAS_TERMIOS) && defined(HAS_SELECT) && defined(HAS_UNISTD)
+    // don't take keyboard controls from piped input
+    keyboard_ = isatty(STDIN_FILENO);
+#endif
 }
 
 void Animate::Animate_impl::close_alternate_buffer()
@@ -225,4 +710,144 @@ void Animate::Animate_impl::reset_signals()
 #endif
 }
 
-void Animate::Animate_impl::reset_cursor_pos() const { std::cout << CSI CUP; }
+void Animate::Animate_impl::reset_cursor_pos(std::ostream & out) const { out << CSI CUP; }
+
+// Ask the terminal if it supports synchronized updates (DEC private mode 2026)
+// with DECRQM, followed by a primary device attributes request. Every terminal
+// answers DA1, so we don't have to wait out the timeout on terminals that
+// don't understand DECRQM
+bool Animate::Animate_impl::query_sync_update_support() const
+{
+#if defined(HAS_TERMIOS) && defined(HAS_SELECT) && defined(HAS_UNISTD)
+    // the query goes out on stdout and the answer comes back on stdin, so both have to be the terminal
+    if(!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO) || args_.output_filename != "-")
+        return false;
+
+    write_frame(SYNC_UPDATE DECRQM DA1);
+
+    // response to DECRQM is CSI ? 2026 ; Ps $ y. Response to DA1 is CSI ? ... c
+    std::string response;
+    const auto timeout = std::chrono::steady_clock::now() + std::chrono::milliseconds{250};
+    while(true)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(timeout - std::chrono::steady_clock::now());
+        if(remaining.count() <= 0)
+            break;
+
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        FD_SET(STDIN_FILENO, &read_fds);
+
+        timeval tv {.tv_sec = static_cast<decltype(tv.tv_sec)>(remaining.count() / 1000000), .tv_usec = static_cast<decltype(tv.tv_usec)>(remaining.count() % 1000000)};
+        if(auto ready = select(STDIN_FILENO + 1, &read_fds, nullptr, nullptr, &tv); ready < 0 && errno == EINTR)
+            continue;
+        else if(ready <= 0)
+            break;
+
+        char c;
+        if(read(STDIN_FILENO, &c, 1) != 1)
+            break;
+
+        response += c;
+
+        // DA1 response ends with 'c', and comes after any DECRQM response
+        if(c == 'c' && response.rfind(CSI "?") != std::string::npos)
+            break;
+    }
+
+    // Ps: 0 - not recognized, 1 - set, 2 - reset, 3 - permanently set, 4 - permanently reset
+    constexpr auto decrpm_prefix = std::string_view{SYNC_UPDATE ";"};
+    if(auto pos = response.find(decrpm_prefix); pos != std::string::npos && pos + std::size(decrpm_prefix) < std::size(response))
+    {
+        auto ps = response[pos + std::size(decrpm_prefix)];
+        return ps == '1' || ps == '2' || ps == '3';
+    }
+#endif
+
+    return false;
+}
+
+void Animate::Animate_impl::write_frame(std::string_view frame) const
+{
+#ifdef HAS_UNISTD
+    std::cout.flush();
+    while(!std::empty(frame))
+    {
+        auto written = write(STDOUT_FILENO, std::data(frame), std::size(frame));
+        if(written < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            throw std::runtime_error{std::string{"Error writing frame: "} + std::strerror(errno)};
+        }
+        frame.remove_prefix(written);
+    }
+#else
+    std::cout.write(std::data(frame), std::size(frame));
+    std::cout.flush();
+#endif
+}
+
+void Animate::Animate_impl::build_quality_levels()
+{
+    quality_levels_.push_back({args_.color, args_.disp_char, 1.0f});
+
+    if(!args_.adaptive_quality)
+        return;
+
+    // each step should roughly halve the amount written per frame
+    if(args_.color == Args::Color::ANSI24)
+        quality_levels_.push_back({Args::Color::ANSI8, quality_levels_.back().disp_char, 1.0f});
+
+    if(quality_levels_.back().disp_char == Args::Disp_char::HALF_BLOCK)
+        quality_levels_.push_back({quality_levels_.back().color, Args::Disp_char::SPACE, 1.0f});
+
+    for(auto scale: {0.7f, 0.5f, 0.35f, 0.25f})
+        quality_levels_.push_back({quality_levels_.back().color, quality_levels_.back().disp_char, scale});
+}
+
+void Animate::Animate_impl::update_display_args(const Image & img)
+{
+    auto & level = quality_levels_[quality_level_];
+
+    display_args_.color = level.color;
+    display_args_.disp_char = level.disp_char;
+
+    if(level.scale < 1.0f)
+    {
+        display_args_.cols = std::max(1, static_cast<int>(static_cast<float>(get_display_cols(img, args_)) * level.scale));
+        if(args_.rows && *args_.rows > 0)
+            display_args_.rows = std::max(1, static_cast<int>(static_cast<float>(*args_.rows) * level.scale));
+    }
+    else
+    {
+        display_args_.cols = args_.cols;
+        display_args_.rows = args_.rows;
+    }
+}
+
+void Animate::Animate_impl::adjust_quality(std::chrono::duration<float> write_time)
+{
+    if(std::size(quality_levels_) < 2 || frame_delay_ <= decltype(frame_delay_)::zero())
+        return;
+
+    // restart the average after every change, so it only reflects the current quality level
+    auto write_load = write_time / frame_delay_;
+    if(frames_since_quality_change_++ == 0)
+        write_load_ = write_load;
+    else
+        write_load_ += write_load_smoothing * (write_load - write_load_);
+
+    auto new_level = quality_level_;
+    if(write_load_ > write_load_high && frames_since_quality_change_ >= quality_step_down_frames && quality_level_ + 1 < std::size(quality_levels_))
+        ++new_level;
+    else if(write_load_ < write_load_low && frames_since_quality_change_ >= quality_step_up_frames && quality_level_ > 0)
+        --new_level;
+
+    if(new_level != quality_level_)
+    {
+        quality_level_ = new_level;
+        frames_since_quality_change_ = 0;
+        clear_screen_ = true;
+    }
+}
@@ -2,7 +2,9 @@
 #define ANIMATE_HPP
 
 #include <chrono>
+#include <functional>
 #include <memory>
+#include <string>
 
 #include "args.hpp"
 #include "codecs/image.hpp"
@@ -18,7 +20,17 @@ public:
     Animate(Animate &&) = delete;
     Animate & operator=(Animate &&) = delete;
 
+    // output of one slide, ready to write to the terminal. Shared, so it's rendered once
+    using Slide = std::shared_ptr<const std::string>;
+
     void display(const Image & img);
+    void play(const Image & img);
+    // show slides 0 to num_slides - 1 one at a time, with get_slide(i) returning slide i. It's called again every
+    // so often for the slide being shown, and a different result is redrawn (ie. after the terminal is resized).
+    // get_slide returns null while a slide isn't ready, and is polled until it is. Meanwhile, keys are handled as
+    // usual, and the previous slide stays up, with a loading message over its last line.
+    // With a non-zero interval, moves to the next slide that long after it's shown
+    void slideshow(std::size_t num_slides, const std::function<Slide(std::size_t)> & get_slide, std::chrono::duration<float> interval);
     void set_framerate(float fps);
     void set_frame_delay(std::chrono::duration<float> delay_s);
 
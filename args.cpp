@@ -1,17 +1,27 @@
 #include "args.hpp"
 
 #include <algorithm>
+#include <array>
+#include <charconv>
 #include <exception>
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <string>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
 #include <cstdlib>
+#include <cstring>
 
 #ifdef HAS_UNISTD
 #include <unistd.h>
 #endif
+#if defined(HAS_DIRENT) && defined(HAS_UNISTD)
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
 #ifdef HAS_IOCTL
 #include <sys/ioctl.h>
 #ifndef STDOUT_FILENO
@@ -25,6 +35,46 @@
 
 #include "cxxopts_wrapper.hpp"
 
+namespace
+{
+    // cxxopts splits each value of a std::vector<std::string> option on commas, which paths can contain.
+    // This overload is found for std::vector<Input_path> instead, and keeps each value whole
+    struct Input_path: std::string {};
+    [[maybe_unused]] void parse_value(const std::string & text, std::vector<Input_path> & value)
+    {
+        value.push_back(Input_path{text});
+    }
+
+    // the files in path, sorted by name, skipping hidden files and subdirectories. Nothing if path isn't a directory
+    std::optional<std::vector<std::string>> list_directory(const std::string & path)
+    {
+    #if defined(HAS_DIRENT) && defined(HAS_UNISTD)
+        auto dir = opendir(path.c_str());
+        if(!dir)
+            return std::nullopt;
+
+        std::vector<std::string> files;
+        while(auto entry = readdir(dir))
+        {
+            if(entry->d_name[0] == '.')
+                continue;
+
+            auto file = path + (path.ends_with('/') ? "" : "/") + entry->d_name;
+            struct stat info;
+            if(stat(file.c_str(), &info) == 0 && S_ISREG(info.st_mode))
+                files.push_back(std::move(file));
+        }
+        closedir(dir);
+
+        std::sort(std::begin(files), std::end(files));
+        return files;
+    #else
+        static_cast<void>(path);
+        return std::nullopt;
+    #endif
+    }
+}
+
 static const std::vector<std::string> input_formats =
 {
     "ANI",
@@ -169,7 +219,15 @@ static const std::vector<std::string> output_formats =
             ("i,invert",   "Invert colors")
             ("o,output",   "Output text file path. Output to stdout if '-'",                                cxxopts::value<std::string>()->default_value("-"), "OUTPUT_FILE")
             ("v,convert",  "Convert input to output file. Supported formats: " + output_format_list,        cxxopts::value<std::string>(),                     "OUTPUT_IMAGE_FILE")
-            ("no-display", "Disable display of image");
+            ("no-display", "Disable display of image")
+            ("memory-limit", "Maximum memory for decoded image data, in MiB. Larger images are decoded at reduced resolution when the format allows it, or fail to load. Animation frames over the limit are moved to a temporary file", cxxopts::value<std::size_t>(), "MIB")
+            ("threads",    "Number of threads to render with. Defaults to one per CPU core", cxxopts::value<unsigned int>(), "THREADS");
+
+    #if defined(HAS_DIRENT) && defined(HAS_UNISTD)
+        options.add_options()
+            ("cache-dir",  "Keep rendered output in DIR, so displaying the same input with the same options again skips decoding it", cxxopts::value<std::string>(), "DIR")
+            ("cache-size", "Maximum size of --cache-dir, in MiB. The least recently used output is removed past this", cxxopts::value<std::size_t>()->default_value("256"), "MIB");
+    #endif
 
         #if defined(FONTCONFIG_FOUND) && defined(FREETYPE_FOUND)
         const std::string font_group = "Text display options";
@@ -195,10 +253,16 @@ static const std::vector<std::string> output_formats =
             ("image-count", "Print number of images / frames and exit")
             ("frame-no",    "Get specified image or frame number. Only valid when image supports multiple animated images. Use --frame-no to choose a frame from an image specified with --image-no in those cases", cxxopts::value<unsigned int>(), "FRAME_NO")
             ("frame-count", "Print number of frames and exit. Only valid when image supports multiple animated images. Use --frame-count to get the frame count for an image specified with --image-no in those cases")
-            ("animate",     "Animate image (implies --no-display)")
+            ("animate",     "Animate image (implies --no-display). While playing: space pauses, left / right step, N g goes to frame N, N t goes to N seconds, q quits")
             ("loop",        "Loop animation (implies --animate")
             ("frame-delay", "Animation delay between frames (in seconds). If not specified, get from image", cxxopts::value<float>(), "FRAME_DELAY")
-            ("framerate",   "Animation framerate (in fps). If not specified, get from image", cxxopts::value<float>(), "FPS");
+            ("framerate",   "Animation framerate (in fps). If not specified, get from image", cxxopts::value<float>(), "FPS")
+            ("no-adaptive-quality", "Don't reduce animation quality (resolution / colors) when the terminal can't keep up with the framerate");
+
+        const std::string slideshow_group = "Slideshow";
+        options.add_options(slideshow_group)
+            ("slideshow", "Show INPUTs one at a time, fit to the terminal. An INPUT that's a directory adds the files in it. While showing: right / left (or n / p) go to the next / previous image, N g goes to image N, space pauses, q quits. The images either side of the one shown are loaded in the background")
+            ("interval",  "Seconds to show each image for in --slideshow. If not specified, waits for a key", cxxopts::value<float>(), "SECONDS");
 
         const std::string filetype_group = "Input file detection override (for formats that can't reliably be identified by file signature)";
         options.add_options(filetype_group)("tga", "Interpret input as a TGA file");
@@ -218,8 +282,19 @@ static const std::vector<std::string> output_formats =
 
         options.add_options(filetype_group)("sif", "Interpret input as a Space Image Format file (from Advent of Code 2019)");
 
+        const std::string batch_group = "Batch mode (more than one INPUT, an @LIST_FILE INPUT, or --null)";
+        options.add_options(batch_group)
+            ("null", "Read NUL-separated input paths from stdin, after any INPUTs");
+
+    #if defined(HAS_SOCKET) && defined(HAS_SIGNAL) && defined(HAS_UNISTD)
+        const std::string server_group = "Server (keeps fonts and lookup tables loaded between runs)";
+        options.add_options(server_group)
+            ("serve",   "Run as a server on a Unix domain socket at SOCKET, handling requests sent with --connect. Font options set the font loaded up front", cxxopts::value<std::string>(), "SOCKET")
+            ("connect", "Send this request to the server at SOCKET, which handles it as if it were run here", cxxopts::value<std::string>(), "SOCKET");
+    #endif
+
         options.add_options()
-            ("input", "Input image path. Read from stdin if -. Supported formats: " + input_format_list, cxxopts::value<std::string>()->default_value("-"));
+            ("input", "Input image path. Read from stdin if -. Supported formats: " + input_format_list, cxxopts::value<std::vector<Input_path>>()->default_value("-"));
 
         options.parse_positional({"input"});
         options.positional_help("INPUT");
@@ -239,7 +314,10 @@ static const std::vector<std::string> output_formats =
                 " Positional arguments:\n"
                 "    INPUT  ";
 
-        auto input_help = "Input image path. Read from stdin if -. Supported formats: " + input_format_list + "\n(default: stdin)";
+        auto input_help = "Input image path. Read from stdin if -. Supported formats: " + input_format_list + "\n(default: stdin)"
+            "\nMultiple INPUTs are processed in batch mode, in parallel. An INPUT of @LIST_FILE adds each line of LIST_FILE as an input."
+            " In batch mode, OUTPUT_FILE and OUTPUT_IMAGE_FILE may contain {name}, {dir}, and {index}, which are replaced by each input's"
+            " file name without extension, its directory, and its position in the inputs";
 
         const int max_col_width = 80;
         const auto indent = std::string{"            "};
@@ -294,6 +372,28 @@ static const std::vector<std::string> output_formats =
             return {};
         }
 
+    #if defined(HAS_SOCKET) && defined(HAS_SIGNAL) && defined(HAS_UNISTD)
+        if(args.count("serve") && args.count("connect"))
+        {
+            std::cerr<<help("Can't specify --serve with --connect")<<'\n';
+            return {};
+        }
+
+        // the server checks everything else, from the client's working directory
+        if(args.count("connect"))
+        {
+            Args client_args{};
+            client_args.connect_socket = args["connect"].as<std::string>();
+            return client_args;
+        }
+
+        if(args.count("serve") && (args.count("input") || args.count("null")))
+        {
+            std::cerr<<help("Can't specify INPUT or --null with --serve")<<'\n';
+            return {};
+        }
+    #endif
+
         if(args.count("rows") && args["rows"].as<int>() == 0)
         {
             std::cerr<<help("Value for --rows cannot be 0")<<'\n';
@@ -390,6 +490,43 @@ static const std::vector<std::string> output_formats =
             return {};
         }
 
+        const bool slideshow = args.count("slideshow");
+        if(slideshow)
+        {
+            // everything that doesn't end with showing each image in the terminal
+            const auto conflicting = std::array<std::pair<std::string, bool>, 7>
+            {{
+                {"output",      args.count("output") > 0},
+                {"convert",     args.count("convert") > 0},
+                {"no-display",  args.count("no-display") > 0},
+                {"animate",     animate},
+                {"image-count", args.count("image-count") > 0},
+                {"frame-count", args.count("frame-count") > 0},
+                {"null",        args.count("null") > 0},
+            }};
+
+            for(auto && [option, given]: conflicting)
+            {
+                if(given)
+                {
+                    std::cerr<<help("Can't specify --" + option + " with --slideshow")<<'\n';
+                    return {};
+                }
+            }
+        }
+
+        if(args.count("interval") && !slideshow)
+        {
+            std::cerr<<help("Can't specify --interval without --slideshow")<<'\n';
+            return {};
+        }
+
+        if(args.count("interval") && args["interval"].as<float>() <= 0.0f)
+        {
+            std::cerr<<help("--interval must be > 0")<<'\n';
+            return {};
+        }
+
         auto frame_delay = args.count("frame-delay") ? args["frame-delay"].as<float>() : 0.0f;
         if(args.count("framerate"))
         {
@@ -403,6 +540,102 @@ static const std::vector<std::string> output_formats =
             }
         }
 
+        if(args.count("memory-limit") && args["memory-limit"].as<std::size_t>() == 0)
+        {
+            std::cerr<<help("Value for --memory-limit must be positive")<<'\n';
+            return {};
+        }
+
+        if(args.count("threads") && args["threads"].as<unsigned int>() == 0)
+        {
+            std::cerr<<help("Value for --threads must be positive")<<'\n';
+            return {};
+        }
+
+    #if defined(HAS_DIRENT) && defined(HAS_UNISTD)
+        if(args["cache-size"].as<std::size_t>() == 0)
+        {
+            std::cerr<<help("Value for --cache-size must be positive")<<'\n';
+            return {};
+        }
+    #endif
+
+        auto inputs = args["input"].as<std::vector<Input_path>>();
+        const bool batch = !slideshow && (std::size(inputs) > 1 || args.count("null")
+            || std::any_of(std::begin(inputs), std::end(inputs), [](const std::string & input) { return input.starts_with('@'); }));
+
+        std::vector<std::string> batch_inputs;
+        if(batch || slideshow)
+        {
+            if(args.count("input"))
+            {
+                for(auto && input: inputs)
+                {
+                    if(!input.starts_with('@'))
+                    {
+                        if(auto files = slideshow ? list_directory(input) : std::nullopt; files)
+                            batch_inputs.insert(std::end(batch_inputs), std::begin(*files), std::end(*files));
+                        else
+                            batch_inputs.push_back(input);
+                        continue;
+                    }
+
+                    auto list_filename = input.substr(1);
+                    std::ifstream list{list_filename};
+                    if(!list)
+                    {
+                        std::cerr<<help("Could not open input list file " + list_filename)<<'\n';
+                        return {};
+                    }
+
+                    for(std::string line; std::getline(list, line);)
+                    {
+                        if(!std::empty(line) && line.back() == '\r')
+                            line.pop_back();
+                        if(!std::empty(line))
+                            batch_inputs.push_back(line);
+                    }
+                }
+            }
+
+            if(args.count("null"))
+            {
+                for(std::string path; std::getline(std::cin, path, '\0');)
+                {
+                    if(!std::empty(path))
+                        batch_inputs.push_back(path);
+                }
+            }
+
+            if(std::empty(batch_inputs))
+            {
+                std::cerr<<help(slideshow ? "No inputs given for --slideshow" : "No inputs given for batch mode")<<'\n';
+                return {};
+            }
+
+            if(animate)
+            {
+                std::cerr<<help("Can't specify --animate in batch mode")<<'\n';
+                return {};
+            }
+
+            // without something to tell them apart, every input would write to the same file
+            auto is_template = [](const std::string & path) { return path.find("{name}") != std::string::npos || path.find("{index}") != std::string::npos; };
+            if(std::size(batch_inputs) > 1)
+            {
+                if(args["output"].as<std::string>() != "-" && !is_template(args["output"].as<std::string>()))
+                {
+                    std::cerr<<help("--output must contain {name} or {index} in batch mode")<<'\n';
+                    return {};
+                }
+                if(args.count("convert") && !is_template(args["convert"].as<std::string>()))
+                {
+                    std::cerr<<help("--convert must contain {name} or {index} in batch mode")<<'\n';
+                    return {};
+                }
+            }
+        }
+
         auto filetype {Args::Force_file::detect};
 
         if(args.count("tga")
@@ -485,7 +718,8 @@ static const std::vector<std::string> output_formats =
         }
 
         return Args{
-            .input_filename        = args["input"].as<std::string>(),
+            .input_filename        = batch || slideshow ? std::string{} : std::string{inputs.front()},
+            .batch_inputs          = std::move(batch_inputs),
             .output_filename       = args["output"].as<std::string>(),
         #if defined(FONTCONFIG_FOUND) && defined(FREETYPE_FOUND)
             .font_name             = args["font"].as<std::string>(),
@@ -510,6 +744,24 @@ static const std::vector<std::string> output_formats =
             .animate               = animate,
             .loop_animation        = static_cast<bool>(args.count("loop")),
             .animation_frame_delay = frame_delay,
+            .adaptive_quality      = !static_cast<bool>(args.count("no-adaptive-quality")),
+            .slideshow             = slideshow,
+            .slideshow_interval    = args.count("interval") ? args["interval"].as<float>() : 0.0f,
+            .memory_limit          = args.count("memory-limit") ? std::optional(args["memory-limit"].as<std::size_t>() * 1024 * 1024) : std::nullopt,
+            .threads               = args.count("threads") ? std::optional(args["threads"].as<unsigned int>()) : std::nullopt,
+        #if defined(HAS_DIRENT) && defined(HAS_UNISTD)
+            .cache_dir             = args.count("cache-dir") ? std::optional(args["cache-dir"].as<std::string>()) : std::nullopt,
+            .cache_size            = args["cache-size"].as<std::size_t>() * 1024 * 1024,
+        #else
+            .cache_dir             = std::nullopt,
+            .cache_size            = {},
+        #endif
+        #if defined(HAS_SOCKET) && defined(HAS_SIGNAL) && defined(HAS_UNISTD)
+            .serve_socket          = args.count("serve") ? std::optional(args["serve"].as<std::string>()) : std::nullopt,
+        #else
+            .serve_socket          = std::nullopt,
+        #endif
+            .connect_socket        = std::nullopt,
         #if CXXOPTS__VERSION_MAJOR >= 3
             .extra_args            = args.unmatched(),
         #else
@@ -540,3 +792,24 @@ int get_screen_cols()
 
     return 0;
 }
+
+int get_screen_rows()
+{
+    // LINES is only trusted when it's a number, otherwise ask the terminal
+    if(auto lines_env = std::getenv("LINES"); lines_env != nullptr)
+    {
+        const auto lines_end = lines_env + std::strlen(lines_env);
+        if(int lines = 0; std::from_chars(lines_env, lines_end, lines).ptr == lines_end && lines > 0)
+            return lines;
+    }
+    #ifdef HAS_IOCTL
+    if(winsize ws; ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) >= 0)
+        return static_cast<int>(ws.ws_row);
+    #endif
+    #ifdef HAS_WINDOWS
+    if(CONSOLE_SCREEN_BUFFER_INFO csbi; GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi))
+        return static_cast<int>(csbi.srWindow.Bottom - csbi.srWindow.Top + 1);
+    #endif
+
+    return 0;
+}
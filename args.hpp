@@ -6,11 +6,14 @@
 #include <utility>
 #include <vector>
 
+#include <cstddef>
+
 #include "config.h"
 
 struct Args
 {
     std::string input_filename;  // - for stdin
+    std::vector<std::string> batch_inputs; // when not empty, each of these is processed in place of input_filename, and output_filename and convert_filename are templates
     std::string output_filename; // - for stdout
     std::string font_name;       // use fontconfig to find, freetype to open
     float       font_size;       // font size requested, in points
@@ -47,6 +50,15 @@ struct Args
     bool animate;
     bool loop_animation;
     float animation_frame_delay;
+    bool adaptive_quality;
+    bool slideshow;                 // show batch_inputs one at a time, full screen
+    float slideshow_interval;       // seconds before moving to the next image, or 0 to wait for a key
+    std::optional<std::size_t> memory_limit; // max bytes of decoded image data
+    std::optional<unsigned int> threads;
+    std::optional<std::string> cache_dir; // keep rendered output here, to reuse for the same input and args
+    std::size_t cache_size;               // max bytes of output kept in cache_dir
+    std::optional<std::string> serve_socket;   // run as a server on this Unix domain socket
+    std::optional<std::string> connect_socket; // send this invocation to the server on this socket, instead of handling it here
     std::vector<std::string> extra_args;
     std::string help_text;
 };
@@ -54,5 +66,6 @@ struct Args
 [[nodiscard]] std::optional<Args> parse_args(int argc, char * argv[]);
 
 int get_screen_cols();
+int get_screen_rows();
 
 #endif // ARGS_HPP
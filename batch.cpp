@@ -0,0 +1,217 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <cstdlib>
+
+#include "display.hpp"
+#include "prefetch.hpp"
+#include "render_cache.hpp"
+#include "thread_pool.hpp"
+#include "codecs/image.hpp"
+
+namespace
+{
+    // only images at least this slow to decode are worth keeping decoded in the cache
+    constexpr auto min_pixel_cache_decode_time = std::chrono::milliseconds{20};
+
+    // how many inputs to read ahead for each thread decoding them in a batch
+    constexpr std::size_t prefetch_per_thread = 2u;
+
+    // replace {name}, {dir}, and {index} in an output path template with the input's file name without extension,
+    // its directory, and its position in the inputs
+    std::string expand_template(const std::string & path_template, const std::string & input, std::size_t index)
+    {
+        auto sep_pos = input.find_last_of("\\/");
+
+        auto dir = sep_pos == std::string::npos ? std::string{"."} : input.substr(0, std::max<std::size_t>(sep_pos, 1u));
+
+        auto name = sep_pos == std::string::npos ? input : input.substr(sep_pos + 1);
+        if(auto ext_pos = name.find_last_of('.'); ext_pos != std::string::npos && ext_pos > 0)
+            name.resize(ext_pos);
+
+        const auto fields = std::array<std::pair<std::string_view, std::string>, 3>
+        {{
+            {"{name}",  name},
+            {"{dir}",   dir},
+            {"{index}", std::to_string(index)},
+        }};
+
+        std::string path;
+        for(std::size_t i = 0; i < std::size(path_template);)
+        {
+            auto field = std::find_if(std::begin(fields), std::end(fields), [&](auto && f) { return path_template.compare(i, std::size(f.first), f.first) == 0; });
+            if(field != std::end(fields))
+            {
+                path += field->second;
+                i += std::size(field->first);
+            }
+            else
+                path += path_template[i++];
+        }
+
+        return path;
+    }
+}
+
+void process_input(const Args & args, std::ostream & standard_out)
+{
+    auto source = open_input(args);
+
+    std::string pixels_key, cache_key;
+    if(Render_cache::can_cache_pixels(args))
+        pixels_key = Render_cache::pixels_key(source->contents(), args);
+
+    if(Render_cache::can_cache(args))
+    {
+        cache_key = Render_cache::key(pixels_key, args);
+        if(Render_cache::get(args).output(cache_key, args, standard_out))
+            return;
+    }
+
+    // a cached decode holds just the images args select, so it's opened without selecting or format args
+    auto image_args = args;
+    auto cached_pixels = !std::empty(pixels_key) ? Render_cache::get(args).open_pixels(pixels_key) : nullptr;
+    if(cached_pixels)
+    {
+        source = std::move(cached_pixels);
+        image_args.force_file = Args::Force_file::detect;
+        image_args.extra_args.clear();
+        image_args.image_no = std::nullopt;
+        image_args.frame_no = std::nullopt;
+    }
+
+    auto decode_start = std::chrono::steady_clock::now();
+    auto img = get_image_data(image_args, *source);
+
+    if(!std::empty(pixels_key) && !cached_pixels && std::chrono::steady_clock::now() - decode_start >= min_pixel_cache_decode_time)
+        Render_cache::get(args).store_pixels(pixels_key, *img, args);
+
+    if(args.get_image_count)
+    {
+        standard_out<<img->num_images()<<'\n';
+        return;
+    }
+
+    if(args.get_frame_count)
+    {
+        standard_out<<img->num_frames()<<'\n';
+        return;
+    }
+
+    if(!img->supports_multiple_images() && image_args.image_no > 0)
+        throw std::runtime_error{args.help_text + "\nImage type doesn't support multiple images"};
+
+    if(!img->supports_animation() && args.animate)
+        throw std::runtime_error{args.help_text + "\nImage type doesn't support animation"};
+
+    if(args.display && !std::empty(cache_key))
+    {
+        // render to a string rather than the output file, to keep a copy for the cache
+        static const auto to_standard_out = std::string{"-"};
+        auto render_args = image_args;
+        render_args.output_filename = to_standard_out;
+        std::ostringstream rendered;
+        display_image(*img, render_args, rendered);
+
+        Render_cache::get(args).store(cache_key, rendered.view());
+        Render_cache::write(rendered.view(), args, standard_out);
+    }
+    else if(args.display)
+    {
+        display_image(*img, image_args, standard_out);
+    }
+
+    if(args.convert_filename)
+    {
+        if(args.frame_no)
+            img->get_frame(*args.frame_no).convert(args);
+        else if(args.image_no)
+            img->get_image(*args.image_no).convert(args);
+        else
+            img->convert(args);
+    }
+}
+
+int process_batch(const Args & args)
+{
+    const auto & inputs = args.batch_inputs;
+
+    // each input is rendered on one thread. With many inputs, working on several at once keeps the threads busier
+    // than splitting up each image, and skips the overhead of doing so
+    auto input_args = args;
+    input_args.batch_inputs.clear();
+    input_args.threads = 1u;
+
+    struct Result
+    {
+        std::string output;
+        std::string error;
+        bool done {false};
+    };
+    std::vector<Result> results(std::size(inputs));
+    std::size_t next_result = 0;
+    bool failed = false;
+    std::mutex mutex;
+
+    Thread_pool pool{args.threads.value_or(0u)};
+
+    // reading inputs ahead keeps the threads decoding instead of waiting on storage
+    Input_prefetcher prefetcher{inputs, pool.size() * prefetch_per_thread};
+
+    pool.parallel_for(std::size(inputs), [&](std::size_t i)
+    {
+        auto this_args = input_args;
+        this_args.input_filename = inputs[i];
+        if(this_args.output_filename != "-")
+            this_args.output_filename = expand_template(this_args.output_filename, inputs[i], i);
+        if(this_args.convert_filename)
+            this_args.convert_filename->first = expand_template(this_args.convert_filename->first, inputs[i], i);
+
+        std::ostringstream output;
+        std::string error;
+        try
+        {
+            prefetcher.take(i);
+            process_input(this_args, output);
+        }
+        catch(Early_exit &)
+        {}
+        catch(const std::exception & e)
+        {
+            error = e.what();
+        }
+
+        std::lock_guard lock{mutex};
+        results[i] = Result{std::move(output).str(), std::move(error), true};
+
+        // write out everything finished, up to the first input still being worked on
+        for(; next_result < std::size(results) && results[next_result].done; ++next_result)
+        {
+            auto & result = results[next_result];
+            std::cout<<result.output;
+            if(!std::empty(result.error))
+            {
+                std::cerr<<inputs[next_result]<<": "<<result.error<<'\n';
+                failed = true;
+            }
+            result.output = std::string{};
+            result.error = std::string{};
+        }
+    });
+
+    std::cout.flush();
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,18 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <iosfwd>
+
+#include "args.hpp"
+
+// decode args.input_filename, then display and / or convert it as args say.
+// Output that would go to stdout goes to standard_out instead
+void process_input(const Args & args, std::ostream & standard_out);
+
+// process each of args.batch_inputs as if it were the only input, several at
+// a time. Output paths are expanded from templates for each input. Output to
+// stdout and errors are written in input order, and an error only stops the
+// input it came from. Returns the exit code
+int process_batch(const Args & args);
+
+#endif // BATCH_HPP
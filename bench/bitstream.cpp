@@ -0,0 +1,187 @@
+// Compares Input_bitstream, which refills 64 bits at a time, with the reader it
+// replaced, which loaded a byte and shifted out one bit at a time. Both decode
+// the same synthetic stream in the layout of Gen 1 Pokemon sprites: alternating
+// RLE packets (a unary bit count, then a value that many bits long) and packets
+// of 2-bit pairs ended by a 00 pair
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "../codecs/bitstream.hpp"
+
+namespace
+{
+    // Input_bitstream before it was buffered, for comparison
+    template <Byte_input_iter InputIter>
+    class Byte_bitstream
+    {
+    public:
+        explicit Byte_bitstream(InputIter in):
+            in_{in}
+        {}
+
+        template <typename T>
+        T read(std::uint8_t bits)
+        {
+            T ret{0};
+            for(std::uint8_t i = 0u; i < bits; ++i)
+            {
+                if(bits_available_ == 0u)
+                {
+                    bits_available_ = 8u;
+                    read_ = *in_++;
+                }
+                ret <<= 1u;
+                ret |= (read_ >> --bits_available_) & 0x01u;
+            }
+            return ret;
+        }
+
+        std::uint8_t operator()(std::uint8_t bits)
+        {
+            return read<std::uint8_t>(bits);
+        }
+
+        // as the Gen 1 decoder read RLE bit counts before read_unary
+        std::size_t read_unary()
+        {
+            std::size_t ones{0};
+            while(read<std::uint8_t>(1))
+                ++ones;
+            return ones;
+        }
+
+    private:
+        InputIter in_;
+        std::uint8_t read_{0u};
+        std::uint8_t bits_available_{0u};
+    };
+
+    struct Stream
+    {
+        std::vector<unsigned char> data;
+        std::size_t num_pairs{0};
+    };
+
+    // about size bytes of packets, with run lengths and data packet lengths like those in real sprites
+    Stream make_stream(std::size_t size)
+    {
+        std::mt19937 rng{1};
+        std::geometric_distribution<unsigned int> run_length{0.1};
+        std::geometric_distribution<unsigned int> data_length{0.3};
+        std::uniform_int_distribution<unsigned int> pair{1u, 3u};
+
+        Stream stream;
+        {
+            Output_bitstream bits{std::back_inserter(stream.data)};
+            bits(0u, 1); // start with RLE
+            while(std::size(stream.data) < size)
+            {
+                // value is stored as value - (2^bit_count - 1), in bit_count bits, after bit_count - 1 1s and a 0
+                auto value = 1u + run_length(rng);
+                auto bit_count = std::bit_width(value + 1u) - 1u;
+                bits((1u << bit_count) - 2u, bit_count);
+                bits(value - ((1u << bit_count) - 1u), bit_count);
+                stream.num_pairs += value;
+
+                for(auto i = 1u + data_length(rng); i > 0u; --i)
+                {
+                    bits(pair(rng), 2);
+                    ++stream.num_pairs;
+                }
+                bits(0u, 2);
+            }
+        }
+        // padding, as the decoder stops at the last pair, and never reads this far
+        stream.data.resize(std::size(stream.data) + 8u);
+        return stream;
+    }
+
+    // decodes like Gen 1 sprite decompression, returning a checksum of the pairs instead of storing them
+    template <typename Bitstream>
+    std::uint64_t decode(Bitstream & bits, std::size_t num_pairs)
+    {
+        std::uint64_t checksum{0};
+        std::size_t pairs{0};
+        enum class State: std::uint8_t {RLE=0, DATA=1};
+        auto state = static_cast<State>(bits(1));
+
+        while(pairs < num_pairs)
+        {
+            if(state == State::RLE)
+            {
+                auto bit_count = static_cast<std::uint8_t>(1u + bits.read_unary());
+                auto value = bits.template read<std::uint16_t>(bit_count);
+                value += (1 << bit_count) - 1;
+
+                pairs += value;
+                checksum = checksum * 31u + value;
+                state = State::DATA;
+            }
+            else
+            {
+                auto pair = bits(2);
+                if(pair == 0)
+                {
+                    state = State::RLE;
+                    continue;
+                }
+                ++pairs;
+                checksum = checksum * 31u + pair;
+            }
+        }
+        return checksum;
+    }
+
+    // fastest of several runs, in ns per byte of input
+    template <typename Decode>
+    double time_decode(const Stream & stream, Decode decode_stream, std::uint64_t & checksum)
+    {
+        constexpr auto runs = 20;
+        auto best = std::chrono::steady_clock::duration::max();
+        for(auto i = 0; i < runs; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            checksum = decode_stream();
+            best = std::min(best, std::chrono::steady_clock::now() - start);
+        }
+        return std::chrono::duration<double, std::nano>{best}.count() / std::size(stream.data);
+    }
+}
+
+int main()
+{
+    constexpr std::size_t stream_size = 4u << 20;
+    auto stream = make_stream(stream_size);
+
+    std::uint64_t buffered_checksum{0}, byte_checksum{0};
+    auto buffered_time = time_decode(stream, [&stream]
+    {
+        auto bits = Input_bitstream{std::begin(stream.data), std::end(stream.data)};
+        return decode(bits, stream.num_pairs);
+    }, buffered_checksum);
+    auto byte_time = time_decode(stream, [&stream]
+    {
+        auto bits = Byte_bitstream{std::begin(stream.data)};
+        return decode(bits, stream.num_pairs);
+    }, byte_checksum);
+
+    if(buffered_checksum != byte_checksum)
+    {
+        std::cerr<<"Decoded streams differ\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout<<"Gen 1 style stream: "<<std::size(stream.data)<<" bytes, "<<stream.num_pairs<<" pairs\n"
+             <<"  64-bit refill:  "<<buffered_time<<" ns/byte\n"
+             <<"  byte at a time: "<<byte_time<<" ns/byte ("<<byte_time / buffered_time<<"x)\n";
+
+    return EXIT_SUCCESS;
+}
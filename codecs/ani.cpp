@@ -17,15 +17,15 @@ void Ani::open(std::istream & input, const Args & args)
     constexpr auto id_size = 4u;
     constexpr auto anih_size = 36u;
 
-    input.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+    auto data = read_input_to_memory(input);
+    Byte_reader in{data};
     try
     {
-        input.ignore(id_size); // RIFF
+        in.skip(id_size); // RIFF
 
-        std::uint32_t file_size;
-        readb(input, file_size);
+        auto file_size = in.read<std::uint32_t>();
 
-        input.ignore(id_size); // ICON
+        in.skip(id_size); // ICON
         auto file_pos = id_size;
 
         std::vector<Ico> frames;
@@ -40,13 +40,12 @@ void Ani::open(std::istream & input, const Args & args)
 
         while(file_pos < file_size)
         {
-            auto chunk_tag = readstr(input, id_size);
+            auto chunk_tag = in.read_string(id_size);
             file_pos += id_size;
             if(chunk_tag == "fram")
                 continue;
 
-            std::uint32_t chunk_size;
-            readb(input, chunk_size);
+            auto chunk_size = in.read<std::uint32_t>();
             file_pos += sizeof(chunk_size);
 
             if(chunk_tag == "LIST")
@@ -55,7 +54,7 @@ void Ani::open(std::istream & input, const Args & args)
             }
             else if(chunk_tag == "INAM" || chunk_tag == "IART")
             {
-                input.ignore(chunk_size);
+                in.skip(chunk_size);
                 file_pos += chunk_size;
             }
             else if(chunk_tag == "anih")
@@ -66,12 +65,12 @@ void Ani::open(std::istream & input, const Args & args)
                 if(header_read)
                     throw std::runtime_error{"Error reading ANI: multiple ani headers detected"};
 
-                input.ignore(sizeof(std::uint32_t)); // bytes in header
-                readb(input, num_frames);
-                readb(input, animation_steps);
-                input.ignore(sizeof(std::uint32_t) * 4); // reserved
-                readb(input, delay_count);
-                input.ignore(sizeof(std::uint32_t)); // flags
+                in.skip(sizeof(std::uint32_t)); // bytes in header
+                in.read(num_frames);
+                in.read(animation_steps);
+                in.skip(sizeof(std::uint32_t) * 4); // reserved
+                in.read(delay_count);
+                in.skip(sizeof(std::uint32_t)); // flags
 
                 file_pos += anih_size;
                 header_read = true;
@@ -79,26 +78,19 @@ void Ani::open(std::istream & input, const Args & args)
             else if(chunk_tag == "rate")
             {
                 for(auto i = 0u; i < chunk_size / sizeof(std::uint32_t); ++i)
-                {
-                    rate.emplace_back();
-                    readb(input, rate.back());
-                }
+                    rate.emplace_back(in.read<std::uint32_t>());
                 file_pos += chunk_size;
             }
             else if(chunk_tag == "seq ")
             {
                 for(auto i = 0u; i < chunk_size / sizeof(std::uint32_t); ++i)
-                {
-                    seq.emplace_back();
-                    readb(input, seq.back());
-                }
+                    seq.emplace_back(in.read<std::uint32_t>());
                 file_pos += chunk_size;
             }
             else if(chunk_tag == "icon")
             {
-                auto ico = std::string(chunk_size, '\0');
-                input.read(std::data(ico), chunk_size);
-                auto ico_input = std::istringstream{ico};
+                // Ico may hand embedded PNGs to libpng, which needs a stream
+                auto ico_input = std::istringstream{in.read_string(chunk_size)};
 
                 frames.emplace_back();
                 frames.back().open(ico_input, args);
@@ -150,12 +142,11 @@ void Ani::open(std::istream & input, const Args & args)
 
         move_image_data(images_.front());
         images_.erase(std::begin(images_));
+
+        deduplicate_frames(args.animate);
     }
-    catch(std::ios_base::failure & e)
+    catch(const Unexpected_end_of_input &)
     {
-        if(input.bad())
-            throw std::runtime_error{"Error reading ANI: could not read file"};
-        else
-            throw std::runtime_error{"Error reading ANI: unexpected end of file"};
+        throw std::runtime_error{"Error reading ANI: unexpected end of file"};
     }
 }
@@ -44,19 +44,12 @@ void Avif::open(std::istream & input, const Args &)
         avifRGBImageAllocatePixels(&rgb);
         avifImageYUVToRGB(decoder->image, &rgb);
 
-        for(std::size_t row = 0; row < height_; ++row)
-        {
-            for(std::size_t col = 0; col < width_; ++col)
-            {
-                auto pixel = rgb.pixels + row * rgb.rowBytes + col * 4;
-                image_data_[row][col] = Color{ pixel[0], pixel[1], pixel[2], pixel[3] };
-            }
-        }
+        import_rows(rgb.pixels, rgb.rowBytes, Pixel_format::RGBA);
 
         avifRGBImageFreePixels(&rgb);
 
-        // rotate as needed
-        transpose_image(orientation);
+        // rotation is applied when displayed or converted
+        set_orientation(orientation);
     }
     catch(...)
     {
@@ -88,22 +81,7 @@ void Avif::write(std::ostream & out, const Image & img, bool invert)
 
     rgb.rowBytes = img.get_width() * 4;
 
-    for(std::size_t row = 0; row < img.get_height(); ++row)
-    {
-        for(std::size_t col = 0; col < img.get_height(); ++col)
-        {
-            auto & color = img[row][col];
-
-            auto pixel = rgb.pixels + row * rgb.rowBytes + col * 4;
-            for(std::size_t i = 0; i < 4; ++i)
-            {
-                if(invert && i < 4)
-                    pixel[i] = 255 - color[i];
-                else
-                    pixel[i] = color[i];
-            }
-        }
-    }
+    img.export_rows(rgb.pixels, rgb.rowBytes, Pixel_format::RGBA, invert);
 
     avifImageRGBToYUV(image, &rgb);
     avifRGBImageFreePixels(&rgb);
@@ -4,9 +4,12 @@
 #include <array>
 #include <bit>
 #include <istream>
+#include <span>
+#include <stdexcept>
 #include <string>
 
 #include <cstdint>
+#include <cstring>
 #include <type_traits>
 
 template<typename T> concept Byte_input_iter =
@@ -175,6 +178,94 @@ std::string readstr(InputIter & begin, InputIter end, std::size_t len)
     return s;
 }
 
+// thrown by Byte_reader when reading past the end of its data
+struct Unexpected_end_of_input: public std::runtime_error
+{
+    Unexpected_end_of_input(): std::runtime_error{"Unexpected end of input"} {}
+};
+
+// Bounds-checked reader over bytes already in memory, like the ones from Image::read_input_to_memory.
+// Much cheaper per field than reading through an istream, and fixed-size loads inline down to a compare and a copy
+class Byte_reader
+{
+public:
+    explicit Byte_reader(std::span<const unsigned char> data): data_{data} {}
+
+    std::size_t tell() const { return pos_; }
+    std::size_t size() const { return std::size(data_); }
+    std::size_t remaining() const { return std::size(data_) - pos_; }
+    bool at_end() const { return pos_ == std::size(data_); }
+
+    void seek(std::size_t pos)
+    {
+        if(pos > std::size(data_))
+            throw Unexpected_end_of_input{};
+        pos_ = pos;
+    }
+
+    void skip(std::size_t n)
+    {
+        check(n);
+        pos_ += n;
+    }
+
+    std::uint8_t get()
+    {
+        check(1);
+        return data_[pos_++];
+    }
+
+    template <typename T> requires (!std::is_enum_v<T>)
+    T read(std::endian endian = std::endian::little)
+    {
+        check(sizeof(T));
+        T t;
+        std::memcpy(&t, std::data(data_) + pos_, sizeof(T));
+        pos_ += sizeof(T);
+
+        if(std::endian::native != endian)
+            t = bswap(t);
+        return t;
+    }
+
+    template <typename E> requires std::is_enum_v<E>
+    E read(std::endian endian = std::endian::little)
+    {
+        return static_cast<E>(read<std::underlying_type_t<E>>(endian));
+    }
+
+    template <typename T>
+    void read(T & t, std::endian endian = std::endian::little)
+    {
+        t = read<T>(endian);
+    }
+
+    // view of the next n bytes, valid as long as the data is
+    std::span<const unsigned char> read_span(std::size_t n)
+    {
+        check(n);
+        auto s = data_.subspan(pos_, n);
+        pos_ += n;
+        return s;
+    }
+
+    std::string read_string(std::size_t n)
+    {
+        auto s = read_span(n);
+        return {reinterpret_cast<const char *>(std::data(s)), std::size(s)};
+    }
+
+private:
+    void check(std::size_t n) const
+    {
+        if(n > remaining())
+            throw Unexpected_end_of_input{};
+    }
+
+    std::span<const unsigned char> data_;
+    std::size_t pos_ {0};
+};
+
 template <typename T> requires(!std::is_enum_v<T>)
 void writeb(std::ostream & o, T t, std::endian endian = std::endian::little)
 {
@@ -1,31 +1,62 @@
 #ifndef BITSTREAM_HPP
 #define BITSTREAM_HPP
 
+#include <algorithm>
+#include <bit>
+#include <iterator>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
 #include "binio.hpp"
 
+// MSB-first bit reader. Buffers up to 64 bits at a time, so reads are a shift
+// and mask rather than a loop over each bit. Contiguous input is refilled a
+// whole word at a time, without branching on how many bytes are needed
 template <Byte_input_iter InputIter>
 class Input_bitstream
 {
 public:
-    explicit Input_bitstream(InputIter in):
-        in_{in}
+    // most bits peek() can return
+    static constexpr std::uint8_t max_peek = 56u;
+
+    Input_bitstream(InputIter begin, InputIter end):
+        in_{begin},
+        end_{end}
     {}
 
+    // next bits of input, without consuming them. Past the end of input, reads as 0s
+    std::uint64_t peek(std::uint8_t bits)
+    {
+        refill();
+        // shifting in two steps allows for bits == 0
+        return (buffer_ >> 1u) >> (63u - bits);
+    }
+
+    void consume(std::uint8_t bits)
+    {
+        if(bits > bits_available_)
+            throw Unexpected_end_of_input{};
+        buffer_ <<= bits;
+        bits_available_ -= bits;
+    }
+
+    // reads any number of bits. Like shifting in one bit at a time, the value keeps the lowest bits that fit in T
     template <typename T>
     T read(std::uint8_t bits)
     {
-        T ret{0};
-        for(std::uint8_t i = 0u; i < bits; ++i)
+        std::uint64_t ret{0};
+        while(bits > max_peek)
         {
-            if(bits_available_ == 0u)
-            {
-                bits_available_ = 8u;
-                read_ = *in_++;
-            }
-            ret <<= 1u;
-            ret |= (read_ >> --bits_available_) & 0x01u;
+            ret = (ret << max_peek) | peek(max_peek);
+            consume(max_peek);
+            bits -= max_peek;
         }
-        return ret;
+
+        ret = (ret << bits) | peek(bits);
+        consume(bits);
+        return static_cast<T>(ret);
     }
 
     std::uint8_t operator()(std::uint8_t bits)
@@ -33,12 +64,70 @@ public:
         return read<std::uint8_t>(bits);
     }
 
+    // number of 1 bits before the next 0, up to the number of bits buffered (at least max_peek before the end of input). Doesn't consume them
+    std::uint8_t count_leading_ones()
+    {
+        refill();
+        return static_cast<std::uint8_t>(std::min<unsigned int>(std::countl_one(buffer_), bits_available_));
+    }
+
+    // reads a unary code: a run of 1 bits, ended by a 0 bit. Returns the number of 1s
+    std::size_t read_unary()
+    {
+        std::size_t ones{0};
+        while(true)
+        {
+            auto count = count_leading_ones();
+            if(count < bits_available_)
+            {
+                consume(count);
+                consume(1u);
+                return ones + count;
+            }
+
+            if(bits_available_ == 0u)
+                throw Unexpected_end_of_input{};
+
+            consume(count);
+            ones += count;
+        }
+    }
+
 private:
+    // tops up the buffer to at least max_peek bits, or to the end of input
+    void refill()
+    {
+        if constexpr(std::contiguous_iterator<InputIter>)
+        {
+            if(end_ - in_ >= 8)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, std::to_address(in_), sizeof(word));
+                if constexpr(std::endian::native == std::endian::little)
+                    word = bswap(word);
+
+                // bits past the whole bytes counted here are reloaded next time, so ORing them in early is harmless
+                buffer_ |= word >> bits_available_;
+                in_ += (63u - bits_available_) >> 3u;
+                bits_available_ |= max_peek;
+                return;
+            }
+        }
+
+        while(bits_available_ < max_peek && in_ != end_)
+        {
+            buffer_ |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(*in_++)) << (max_peek - bits_available_);
+            bits_available_ += 8u;
+        }
+    }
+
     InputIter in_;
-    std::uint8_t read_{0u};
+    InputIter end_;
+    std::uint64_t buffer_{0u}; // unread bits, starting from the MSB. Followed by 0s, or by input not yet counted in bits_available_
     std::uint8_t bits_available_{0u};
 };
 
+// MSB-first bit writer. Collects bits into a 64-bit buffer, only writing out bytes once it fills
 template <Byte_output_iter OutputIter>
 class Output_bitstream
 {
@@ -57,21 +146,22 @@ public:
     Output_bitstream(Output_bitstream &&) = default;
     Output_bitstream & operator=(Output_bitstream &&) = default;
 
+    // writes the lowest bits of t
     template <typename T>
     void write(const T & t, std::uint8_t bits)
     {
-        for(auto i = bits; i-- > 0u;)
+        auto value = static_cast<std::uint64_t>(t);
+        if(bits > max_write)
         {
-            if(bits_available_ == 0u)
-            {
-                bits_available_ = 8u;
-                *out_++ = written_;
-                written_ = 0u;
-            }
-            written_ <<= 1;
-            written_ |= (t >> i) & 0x01u;
-            --bits_available_;
+            write(value >> max_write, bits - max_write);
+            bits = max_write;
         }
+
+        if(bits_written_ + bits > 64u)
+            write_bytes();
+
+        written_ = (written_ << bits) | (value & ((std::uint64_t{1} << bits) - 1u));
+        bits_written_ += bits;
     }
 
     template <typename T>
@@ -80,19 +170,33 @@ public:
         write(t, bits);
     }
 
+    // writes out all buffered bits, padding the last byte with 0s
     void flush_current_byte()
     {
-        if(bits_available_ < 8u)
+        write_bytes();
+        if(bits_written_ > 0u)
         {
-            written_ <<= bits_available_;
-            *out_++ = written_;
-            bits_available_ = 8u;
+            *out_++ = static_cast<std::uint8_t>(written_ << (8u - bits_written_));
+            bits_written_ = 0u;
         }
     }
 
 private:
+    // after write_bytes, there is always room for this many more bits
+    static constexpr std::uint8_t max_write = 56u;
+
+    // writes out all complete bytes, leaving fewer than 8 bits buffered
+    void write_bytes()
+    {
+        while(bits_written_ >= 8u)
+        {
+            bits_written_ -= 8u;
+            *out_++ = static_cast<std::uint8_t>(written_ >> bits_written_);
+        }
+    }
+
     OutputIter out_;
-    std::uint8_t written_{0u};
-    std::uint8_t bits_available_{8u};
+    std::uint64_t written_{0u}; // the last bits_written_ bits are buffered, earlier bits are already written
+    std::uint8_t bits_written_{0u};
 };
 #endif // BITSTREAM_HPP
@@ -1,6 +1,7 @@
 #include "bmp.hpp"
 
 #include <stdexcept>
+#include <utility>
 
 #include <cstdint>
 
@@ -8,25 +9,22 @@
 
 void Bmp::open(std::istream & input, const Args &)
 {
-    input.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+    auto data = read_input_to_memory(input);
+    Byte_reader in{data};
     try
     {
-        std::size_t file_pos {0}; // need to keep track of where we are in the file because in.tellg() fails on at least some pipe inputs
-
         bmp_data bmp;
-        read_bmp_file_header(input, bmp, file_pos);
-        read_bmp_info_header(input, bmp, file_pos);
+        read_bmp_file_header(in, bmp);
+        read_bmp_info_header(in, bmp);
 
         set_size(bmp.width, bmp.height);
 
-        read_bmp_data(input, bmp, file_pos, image_data_);
+        read_bmp_data(in, bmp, image_data_);
+        set_source_palette(std::move(bmp.palette));
     }
-    catch(std::ios_base::failure&)
+    catch(const Unexpected_end_of_input &)
     {
-        if(input.bad())
-            throw std::runtime_error{"Error reading BMP: could not read file"};
-        else
-            throw std::runtime_error{"Error reading BMP: unexpected end of file"};
+        throw std::runtime_error{"Error reading BMP: unexpected end of file"};
     }
 }
 
@@ -3,45 +3,41 @@
 #include <bitset>
 #include <stdexcept>
 
+#include <cstring>
+
 #include "binio.hpp"
 
-void read_bmp_file_header(std::istream & in, bmp_data & bmp, std::size_t & file_pos)
+void read_bmp_file_header(Byte_reader & in, bmp_data & bmp)
 {
-    in.ignore(10);
-    readb(in, bmp.pixel_offset);
-    file_pos += 14;
+    in.skip(10);
+    in.read(bmp.pixel_offset);
 }
 
-void read_bmp_info_header(std::istream & in, bmp_data & bmp, std::size_t & file_pos)
+void read_bmp_info_header(Byte_reader & in, bmp_data & bmp)
 {
-    std::uint32_t header_size {0};
-    readb(in, header_size);
-
-    // file_pos += 4;
-    file_pos = 18;
+    const auto header_start = in.tell();
+    auto header_size = in.read<std::uint32_t>();
 
     switch(header_size)
     {
         case 12: // BITMAPCOREHEADER
         {
             std::int16_t width, height;
-            readb(in, width);
+            in.read(width);
             if(width < 0)
                 width = -width;
             bmp.width = width;
 
-            readb(in, height);
+            in.read(height);
             if(height < 0)
             {
                 height = -height;
                 bmp.bottom_to_top = false;
             }
             bmp.height = height;
-            in.ignore(2);
-
-            readb(in, bmp.bpp);
+            in.skip(2);
 
-            file_pos += 8;
+            in.read(bmp.bpp);
 
             break;
         }
@@ -51,12 +47,12 @@ void read_bmp_info_header(std::istream & in, bmp_data & bmp, std::size_t & file_
         case 124: // BITMAPV5HEADER
         {
             std::int32_t width, height;
-            readb(in, width);
+            in.read(width);
             if(width < 0)
                 width = -width;
             bmp.width = width;
 
-            readb(in, height);
+            in.read(height);
             if(height < 0)
             {
                 height = -height;
@@ -64,25 +60,21 @@ void read_bmp_info_header(std::istream & in, bmp_data & bmp, std::size_t & file_
             }
             bmp.height = height;
 
-            in.ignore(2);
-            readb(in, bmp.bpp);
+            in.skip(2);
+            in.read(bmp.bpp);
 
-            readb(in, bmp.compression);
+            in.read(bmp.compression);
 
-            in.ignore(12);
-            readb(in, bmp.palette_size);
-            in.ignore(4);
-
-            file_pos += 36;
+            in.skip(12);
+            in.read(bmp.palette_size);
+            in.skip(4);
 
             if(header_size > 40) // V3+
             {
-                readb(in, bmp.red_mask);
-                readb(in, bmp.green_mask);
-                readb(in, bmp.blue_mask);
-                readb(in, bmp.alpha_mask);
-
-                file_pos += 16;
+                in.read(bmp.red_mask);
+                in.read(bmp.green_mask);
+                in.read(bmp.blue_mask);
+                in.read(bmp.alpha_mask);
             }
             break;
         }
@@ -91,16 +83,13 @@ void read_bmp_info_header(std::istream & in, bmp_data & bmp, std::size_t & file_
     }
 
     // skip to end of header
-    in.ignore(14 + header_size - file_pos); // file header is 14 bytes
-    file_pos = 14 + header_size;
+    in.seek(header_start + header_size);
 
     if(header_size == 40 && bmp.compression == bmp_data::Compression::BI_BITFIELDS)
     {
-        readb(in, bmp.red_mask);
-        readb(in, bmp.green_mask);
-        readb(in, bmp.blue_mask);
-
-        file_pos += 12;
+        in.read(bmp.red_mask);
+        in.read(bmp.green_mask);
+        in.read(bmp.blue_mask);
     }
 
     if(bmp.bpp != 1 && bmp.bpp != 4 && bmp.bpp != 8 && bmp.bpp != 16 && bmp.bpp != 24 && bmp.bpp != 32)
@@ -129,7 +118,8 @@ void read_bmp_info_header(std::istream & in, bmp_data & bmp, std::size_t & file_
     if(bmp.bpp < 16)
     {
         bmp.palette.resize(bmp.palette_size == 0 ? std::uint64_t{1}<<bmp.bpp : bmp.palette_size);
-        in.read(reinterpret_cast<char*>(std::data(bmp.palette)), std::size(bmp.palette) * sizeof(Color));
+        auto palette = in.read_span(std::size(bmp.palette) * sizeof(Color));
+        std::memcpy(std::data(bmp.palette), std::data(palette), std::size(palette));
 
         // convert BGR to RGB
         for(auto && i: bmp.palette)
@@ -137,28 +127,25 @@ void read_bmp_info_header(std::istream & in, bmp_data & bmp, std::size_t & file_
             std::swap(i.r, i.b);
             i.a = 0xFF;
         }
-
-        file_pos += std::size(bmp.palette) * sizeof(Color);
     }
 
     // skip to pixel data (if we know the offset)
     if(bmp.pixel_offset != 0)
     {
-        if(file_pos > bmp.pixel_offset)
+        if(in.tell() > bmp.pixel_offset)
             throw std::runtime_error {"Invalid BMP pixel offset value"};
 
-        in.ignore(bmp.pixel_offset - file_pos);
-        file_pos = bmp.pixel_offset;
+        in.seek(bmp.pixel_offset);
     }
 }
 
-void read_uncompressed(std::istream & in, const bmp_data & bmp, std::vector<std::vector<Color>> & image_data)
+void read_uncompressed(Byte_reader & in, const bmp_data & bmp, Pixel_rows & image_data)
 {
-    std::vector<unsigned char> rowbuf((bmp.bpp * bmp.width + 31) / 32  * 4); // ceiling division
+    const auto row_size = (bmp.bpp * bmp.width + 31) / 32  * 4; // ceiling division
     for(std::size_t row = 0; row < bmp.height; ++row)
     {
         auto im_row = bmp.bottom_to_top ? bmp.height - row - 1 : row;
-        in.read(reinterpret_cast<char *>(std::data(rowbuf)), std::size(rowbuf));
+        auto rowbuf = in.read_span(row_size);
 
         for(std::size_t col = 0; col < bmp.width; ++col)
         {
@@ -176,7 +163,8 @@ void read_uncompressed(std::istream & in, const bmp_data & bmp, std::vector<std:
 
                 image_data[im_row][col] = bmp.palette[packed >> 4];
 
-                image_data[im_row][col+ 1] = bmp.palette[packed & 0xF];
+                if(col + 1 < bmp.width)
+                    image_data[im_row][col + 1] = bmp.palette[packed & 0xF];
             }
             else if(bmp.bpp == 8)
             {
@@ -271,7 +259,7 @@ void read_uncompressed(std::istream & in, const bmp_data & bmp, std::vector<std:
     }
 }
 
-void read_rle(std::istream & in, const bmp_data & bmp, std::vector<std::vector<Color>> & image_data, std::size_t & file_pos)
+void read_rle(Byte_reader & in, const bmp_data & bmp, Pixel_rows & image_data)
 {
     std::size_t row = 0, col = 0;
     auto im_row = bmp.bottom_to_top ? bmp.height - row - 1 : row;
@@ -285,12 +273,10 @@ void read_rle(std::istream & in, const bmp_data & bmp, std::vector<std::vector<C
     while(true)
     {
         unsigned char count = in.get();
-        ++file_pos;
 
         if(count == 0)
         {
             unsigned char escape = in.get();
-            ++file_pos;
 
             if(escape == 0) // end of line
             {
@@ -306,7 +292,6 @@ void read_rle(std::istream & in, const bmp_data & bmp, std::vector<std::vector<C
             {
                 unsigned char horiz = in.get();
                 unsigned char vert = in.get();
-                file_pos += 2;
 
                 col += horiz;
                 row += vert;
@@ -323,7 +308,6 @@ void read_rle(std::istream & in, const bmp_data & bmp, std::vector<std::vector<C
                         if(i % 2 == 0)
                         {
                             idx = in.get();
-                            ++file_pos;
                             color = bmp.palette[idx >> 4];
                         }
                         else
@@ -340,23 +324,18 @@ void read_rle(std::istream & in, const bmp_data & bmp, std::vector<std::vector<C
                     for(auto i = 0; i < escape; ++i)
                     {
                         auto color = bmp.palette[in.get()];
-                        ++file_pos;
                         check_bounds();
                         image_data[im_row][col++] = color;
                     }
                 }
                 // align to word boundary
-                if(file_pos % 2 != 0)
-                {
-                    in.ignore(1);
-                    ++file_pos;
-                }
+                if(in.tell() % 2 != 0)
+                    in.skip(1);
             }
         }
         else
         {
             unsigned char idx = in.get();
-            ++file_pos;
             if(bmp.bpp == 4)
             {
                 for(auto i = 0; i < count; ++i)
@@ -379,12 +358,12 @@ void read_rle(std::istream & in, const bmp_data & bmp, std::vector<std::vector<C
     }
 }
 
-void read_bmp_data(std::istream & in, const bmp_data & bmp, std::size_t & file_pos, std::vector<std::vector<Color>> & image_data)
+void read_bmp_data(Byte_reader & in, const bmp_data & bmp, Pixel_rows & image_data)
 {
     if(bmp.compression == bmp_data::Compression::BI_RGB || bmp.compression == bmp_data::Compression::BI_BITFIELDS)
         read_uncompressed(in, bmp, image_data);
     else if(bmp.compression == bmp_data::Compression::BI_RLE8 || bmp.compression == bmp_data::Compression::BI_RLE4)
-        read_rle(in, bmp, image_data, file_pos);
+        read_rle(in, bmp, image_data);
 }
 
 void write_bmp_file_header(std::ostream & out, std::uint32_t width, std::uint32_t height, bool v4_header)
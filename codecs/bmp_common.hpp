@@ -4,6 +4,7 @@
 #include <stdexcept>
 #include <cstdint>
 
+#include "binio.hpp"
 #include "image.hpp"
 
 struct bmp_data
@@ -23,9 +24,10 @@ struct bmp_data
     std::vector<Color> palette;
 };
 
-void read_bmp_file_header(std::istream & in, bmp_data & bmp, std::size_t & file_pos);
-void read_bmp_info_header(std::istream & in, bmp_data & bmp, std::size_t & file_pos);
-void read_bmp_data(std::istream & in, const bmp_data & bmp, std::size_t & file_pos, std::vector<std::vector<Color>> & image_data);
+// offsets in the data, like bmp.pixel_offset and RLE padding, are relative to the start of in
+void read_bmp_file_header(Byte_reader & in, bmp_data & bmp);
+void read_bmp_info_header(Byte_reader & in, bmp_data & bmp);
+void read_bmp_data(Byte_reader & in, const bmp_data & bmp, Pixel_rows & image_data);
 
 // writing functions create a V4 or V1 32bpp RGBA bitmap
 void write_bmp_file_header(std::ostream & out, std::uint32_t width, std::uint32_t height, bool v4_header = true);
@@ -62,14 +62,10 @@ void Bpg::open(std::istream & input, const Args &)
             bpg_decoder_close(decoder);
             throw std::runtime_error{"Could not read BPG image"};
         }
-        for(std::size_t col = 0; col < width_; ++col)
-            image_data_[row][col] = { row_buffer[col * 4],
-                                      row_buffer[col * 4 + 1],
-                                      row_buffer[col * 4 + 2],
-                                      row_buffer[col * 4 + 3] };
+        import_rows(std::data(row_buffer), 0, Pixel_format::RGBA, row, 1);
     }
 
     bpg_decoder_close(decoder);
 
-    transpose_image(orientation);
+    set_orientation(orientation);
 }
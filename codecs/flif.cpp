@@ -49,16 +49,12 @@ void Flif::open(std::istream & input, const Args &)
     for(std::size_t row = 0; row < height_; ++row)
     {
         flif_image_read_row_RGBA8(image, row, std::data(row_buffer), std::size(row_buffer));
-        for(std::size_t col = 0; col < width_; ++col)
-            image_data_[row][col] = { row_buffer[col * 4],
-                                      row_buffer[col * 4 + 1],
-                                      row_buffer[col * 4 + 2],
-                                      row_buffer[col * 4 + 3] };
+        import_rows(std::data(row_buffer), 0, Pixel_format::RGBA, row, 1);
     }
 
     flif_destroy_decoder(decoder);
 
-    transpose_image(orientation);
+    set_orientation(orientation);
 }
 #endif
 
@@ -79,16 +75,7 @@ void Flif::write(std::ostream & out, const Image & img, bool invert)
     std::vector<unsigned char> row_buffer(img.get_width() *4);
     for(std::size_t row = 0; row < img.get_height(); ++row)
     {
-        for(std::size_t col = 0; col < img.get_width(); ++col)
-        {
-            for(std::size_t i = 0; i < 4; ++i)
-            {
-                if(i < 3 && invert)
-                    row_buffer[col * 4 + i] = 255 - img[row][col][i];
-                else
-                    row_buffer[col * 4 + i] = img[row][col][i];
-            }
-        }
+        img.export_rows(std::data(row_buffer), 0, Pixel_format::RGBA, invert, row, 1);
 
         flif_image_write_row_RGBA8(image, row, std::data(row_buffer), std::size(row_buffer));
     }
@@ -3,6 +3,8 @@
 #include <iostream>
 #include <map>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include <cstdlib>
 #include <cstring>
@@ -32,7 +34,7 @@ int read_fn(GifFileType* gif_file, GifByteType * data, int length) noexcept
     return in->gcount();
 }
 
-void Gif::open(std::istream & input, const Args &)
+void Gif::open(std::istream & input, const Args & args)
 {
     int error_code = GIF_OK;
     GifFileType * gif = DGifOpen(&input, read_fn, &error_code);
@@ -112,12 +114,28 @@ void Gif::open(std::istream & input, const Args &)
             }
         }
         if(composed_)
+        {
             frame.copy_image_data(*this);
+
+            // only this frame's sub-image has changed from the previous composed frame
+            if(f > 0)
+                frame.set_dirty_rect(Rect{static_cast<std::size_t>(left), static_cast<std::size_t>(top), sub_width, sub_height});
+        }
+
+        // only a hint for composed frames, which may also hold colors from earlier frames' palettes
+        std::vector<Color> source_palette;
+        for(auto i = 0; i < pal->ColorCount; ++i)
+            source_palette.emplace_back(pal->Colors[i].Red, pal->Colors[i].Green, pal->Colors[i].Blue);
+        frame.set_source_palette(std::move(source_palette));
+
+        use_stored_image(std::size(images_) - 1);
     }
 
     move_image_data(images_.front());
     images_.erase(std::begin(images_));
     DGifCloseFile(gif, NULL);
+
+    deduplicate_frames(args.animate);
 }
 
 void Gif::handle_extra_args(const Args & args)
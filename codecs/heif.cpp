@@ -36,32 +36,15 @@ void Heif::open(std::istream & input, const Args &)
         if(!plane)
             throw std::runtime_error{"Error reading HEIF image data"};
 
-        for(std::size_t row = 0; row < height_; ++row)
-        {
-            for(std::size_t col = 0; col < width_; ++col)
-            {
-                if(image.get_chroma_format() == heif_chroma_interleaved_RGBA)
-                {
-                    image_data_[row][col] = Color{plane[row * row_stride + col * 4],
-                                                  plane[row * row_stride + col * 4 + 1],
-                                                  plane[row * row_stride + col * 4 + 2],
-                                                  plane[row * row_stride + col * 4 + 3]};
-                }
-                else if(image.get_chroma_format() == heif_chroma_interleaved_RGB)
-                {
-                    image_data_[row][col] = Color{plane[row * row_stride +  col * 3],
-                                                  plane[row * row_stride +  col * 3 + 1],
-                                                  plane[row * row_stride +  col * 3 + 2]};
-                }
-                else if(image.get_chroma_format() == heif_chroma_monochrome)
-                {
-                    image_data_[row][col] = Color{plane[row * row_stride +  col]};
-                }
-            }
-        }
-
-        // rotate as needed
-        transpose_image(orientation);
+        if(image.get_chroma_format() == heif_chroma_interleaved_RGBA)
+            import_rows(plane, row_stride, Pixel_format::RGBA);
+        else if(image.get_chroma_format() == heif_chroma_interleaved_RGB)
+            import_rows(plane, row_stride, Pixel_format::RGB);
+        else if(image.get_chroma_format() == heif_chroma_monochrome)
+            import_rows(plane, row_stride, Pixel_format::GRAY);
+
+        // rotation is applied when displayed or converted
+        set_orientation(orientation);
     }
     catch(const heif::Error & e)
     {
@@ -82,19 +65,7 @@ void Heif::write(std::ostream & out, const Image & img, bool invert)
         if(!plane)
             throw std::runtime_error{"Error writing HEIF image data"};
 
-        for(std::size_t row = 0; row < img.get_height(); ++row)
-        {
-            for(std::size_t col = 0; col < img.get_width(); ++col)
-            {
-                for(std::size_t i = 0; i < 4; ++i)
-                {
-                    if(invert && i < 3)
-                        plane[row * row_stride + col * 4 + i] = 255 - img[row][col][i];
-                    else
-                        plane[row * row_stride + col * 4 + i] = img[row][col][i];
-                }
-            }
-        }
+        img.export_rows(plane, row_stride, Pixel_format::RGBA, invert);
 
         heif::Context context;
         heif::Encoder encoder(heif_compression_HEVC);
@@ -1,7 +1,9 @@
 #include "ico.hpp"
 
+#include <algorithm>
 #include <sstream>
 #include <stdexcept>
+#include <utility>
 
 #include <cstdint>
 
@@ -19,39 +21,43 @@ struct Ico_header
 
 void Ico::open(std::istream & input, const Args & args)
 {
-    input.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+    const auto start = input.tellg();
+    auto data = read_input_to_memory(input);
+    Byte_reader in{data};
     try
     {
         Ico_header ico;
 
-        input.ignore(4); // skip 0 and type
+        in.skip(4); // skip 0 and type
 
-        std::uint16_t num_images;
-        readb(input, num_images);
+        auto num_images = in.read<std::uint16_t>();
 
         if(num_images == 0)
             throw std::runtime_error{"Error reading ICO / CUR: 0 images"};
 
-        readb(input, ico.width);
-        readb(input, ico.height);
-        input.ignore(6); // skip data we can get from the image itself
-        readb(input, ico.size);
-        readb(input, ico.offset);
+        in.read(ico.width);
+        in.read(ico.height);
+        in.skip(6); // skip data we can get from the image itself
+        in.read(ico.size);
+        in.read(ico.offset);
 
         // skip to image data
-        input.ignore(ico.offset - 6 - 16); // 6 for ICONDIR, 16 per ICONDIRENTRY
+        in.seek(ico.offset);
 
         // determine if image data is BMP or PNG
         Image::Header header;
-        input.read(std::data(header), std::size(header));
-        for(auto i = std::rbegin(header); i != std::rend(header); ++i)
-            input.putback(*i);
+        auto header_bytes = in.read_span(std::size(header));
+        std::copy(std::begin(header_bytes), std::end(header_bytes), std::begin(header));
 
         if(is_png(header))
         {
             #ifdef PNG_FOUND
+            // libpng reads from a stream. Point the input at the PNG data
+            input.clear();
+            if(!input.seekg(start + static_cast<std::streamoff>(ico.offset)))
+                throw std::runtime_error{"Error reading ICO / CUR: could not seek to PNG data"};
+
             Png png_img;
-            input.exceptions(std::ios_base::goodbit); // disable our own IO exceptions - PNG handles it differently
             png_img.open(input, args);
             move_image_data(png_img);
             #else
@@ -64,9 +70,11 @@ void Ico::open(std::istream & input, const Args & args)
         width_ = ico.width ? ico.width : 256;
         height_ = ico.height ? ico.width: 256;
 
-        std::size_t file_pos {0};
+        // BMP offsets are relative to the start of its data
+        Byte_reader bmp_in{std::span<const unsigned char>{data}.subspan(ico.offset)};
+
         bmp_data bmp;
-        read_bmp_info_header(input, bmp, file_pos);
+        read_bmp_info_header(bmp_in, bmp);
 
         if(bmp.width != width_ || (bmp.height != height_ && bmp.height != 2 * height_))
             throw std::runtime_error{"Error reading ICO / CUR: size mismatch"};
@@ -78,7 +86,9 @@ void Ico::open(std::istream & input, const Args & args)
             bmp.height = ico.height;
 
         // get XOR mask
-        read_bmp_data(input, bmp, file_pos, image_data_);
+        read_bmp_data(bmp_in, bmp, image_data_);
+        if(!has_and_mask || bmp.bpp == 32)
+            set_source_palette(std::move(bmp.palette));
 
         // get & apply AND mask
         if(has_and_mask && bmp.bpp != 32)
@@ -87,7 +97,7 @@ void Ico::open(std::istream & input, const Args & args)
             bmp.palette = {Color{0, 0, 0, 0xFF}, Color{0, 0, 0, 0x00}};
             auto and_mask = image_data_;
 
-            read_bmp_data(input, bmp, file_pos, and_mask);
+            read_bmp_data(bmp_in, bmp, and_mask);
 
             for(std::size_t row = 0; row < height_; ++row)
             {
@@ -96,12 +106,9 @@ void Ico::open(std::istream & input, const Args & args)
             }
         }
     }
-    catch(std::ios_base::failure&)
+    catch(const Unexpected_end_of_input &)
     {
-        if(input.bad())
-            throw std::runtime_error{"Error reading ICO / CUR: could not read file"};
-        else
-            throw std::runtime_error{"Error reading ICO / CUR: unexpected end of file"};
+        throw std::runtime_error{"Error reading ICO / CUR: unexpected end of file"};
     }
 }
 
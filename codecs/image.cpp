@@ -1,6 +1,9 @@
 #include "image.hpp"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
 #include <fstream>
 #include <iostream>
 #include <iterator>
@@ -8,7 +11,11 @@
 #include <memory>
 #include <set>
 #include <stdexcept>
+#include <thread>
 #include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 
 #include <cassert>
 #include <cmath>
@@ -21,6 +28,8 @@
 #include <byteswap.h>
 #endif
 
+#include "../thread_pool.hpp"
+
 #include "ani.hpp"
 #include "avif.hpp"
 #include "bmp.hpp"
@@ -37,6 +46,7 @@
 #include "motologo.hpp"
 #include "openexr.hpp"
 #include "pcx.hpp"
+#include "pixel_cache.hpp"
 #include "pkmn_gen1.hpp"
 #include "pkmn_gen2.hpp"
 #include "png.hpp"
@@ -53,49 +63,118 @@ const char * Early_exit::what() const noexcept { return "Success"; }
 
 bool Image::header_cmp(unsigned char a, char b){ return a == static_cast<unsigned char>(b); };
 
-std::vector<unsigned char> Image::read_input_to_memory(std::istream & input)
+Input_data Image::read_input_to_memory(std::istream & input)
 {
-    // read whole stream into memory
-    std::vector<unsigned char> data;
-    std::array<char, 4096> buffer;
+    // an Input_source has the data in memory already, either mapped or spooled to a mapped temp file
+    if(auto source = dynamic_cast<Input_source *>(input.rdbuf()))
+    {
+        auto data = source->read_remaining();
+        input.setstate(std::ios_base::eofbit);
+        return Input_data{data};
+    }
+
+    // read whole stream into memory. Size the buffer to fit if the stream can tell us the size (+1 to hit EOF without
+    // growing), otherwise double it as needed
+    std::size_t capacity = 64 * 1024;
+    if(auto start = input.tellg(); start != std::istream::pos_type(-1))
+    {
+        input.seekg(0, std::ios_base::end);
+        if(auto end = input.tellg(); end != std::istream::pos_type(-1) && end >= start)
+            capacity = static_cast<std::size_t>(end - start) + 1;
+        input.seekg(start);
+    }
+
+    std::vector<unsigned char> data(capacity);
+    std::size_t size = 0;
     while(input)
     {
-        input.read(std::data(buffer), std::size(buffer));
+        if(size == std::size(data))
+            data.resize(std::size(data) * 2);
+
+        input.read(reinterpret_cast<char *>(std::data(data)) + size, std::size(data) - size);
         if(input.bad())
             throw std::runtime_error {"Error reading input file"};
 
-        data.insert(std::end(data), std::begin(buffer), std::begin(buffer) + input.gcount());
+        size += input.gcount();
     }
-    return data;
+    data.resize(size);
+
+    return Input_data{std::move(data)};
+}
+
+bool Image::fits_memory_limit(std::size_t w, std::size_t h, std::size_t bytes_per_pixel)
+{
+    if(!memory_limit_)
+        return true;
+
+    return w == 0 || h == 0 || (*memory_limit_ / bytes_per_pixel / w >= h);
 }
 
 void Image::set_size(std::size_t w, std::size_t h)
 {
+    if(!fits_memory_limit(w, h))
+        throw std::runtime_error{"Image size (" + std::to_string(w) + "x" + std::to_string(h) + ") exceeds memory limit"};
+
     width_ = w; height_ = h;
     image_data_.resize(height_);
     for(auto && row: image_data_)
         row.resize(width_);
 }
 
+void Image::set_size(std::size_t w, std::size_t h, const std::vector<Color> & palette)
+{
+    if(std::size(palette) > 256)
+        throw std::logic_error{"Indexed image palette has more than 256 colors"};
+    if(!fits_memory_limit(w, h, 1))
+        throw std::runtime_error{"Image size (" + std::to_string(w) + "x" + std::to_string(h) + ") exceeds memory limit"};
+
+    width_ = w; height_ = h;
+    image_data_.set_indexed(w, h, palette);
+    source_palette_ = palette;
+}
+
+// rotate pixel data. 90 and 270 degree rotations are done in square tiles, so
+// both the source and destination stay in cache
 void Image::transpose_image(exif::Orientation orientation)
 {
     if(orientation == exif::Orientation::r_90 || orientation == exif::Orientation::r_270)
     {
-        // prepare a buffer for transposed data if rotated 90 or 270 degrees
-        decltype(image_data_) transpose_buf;
+        constexpr std::size_t tile_size = 64;
+
+        // the source is read through const rows, so they aren't copied, which needs them expanded first
+        image_data_.expand();
 
-        transpose_buf.resize(width_);
+        Pixel_rows transpose_buf(width_);
         for(auto & row: transpose_buf)
             row.resize(height_);
 
-        for(std::size_t row = 0; row < width_; ++row)
+        const auto & src = std::as_const(image_data_);
+        std::array<const Color *, tile_size> src_rows;
+        std::array<Color *, tile_size> dest_rows;
+
+        for(std::size_t tile_row = 0; tile_row < height_; tile_row += tile_size)
         {
-            for(std::size_t col = 0; col < height_; ++col)
+            const auto rows = std::min(tile_size, height_ - tile_row);
+            for(std::size_t i = 0; i < rows; ++i)
+                src_rows[i] = std::data(src[tile_row + i]);
+
+            for(std::size_t tile_col = 0; tile_col < width_; tile_col += tile_size)
             {
-                if(orientation == exif::Orientation::r_90)
-                    transpose_buf[row][col] = image_data_[col][width_ - row - 1];
-                else // r_270
-                    transpose_buf[row][col] = image_data_[height_ - col - 1][row];
+                const auto cols = std::min(tile_size, width_ - tile_col);
+                for(std::size_t i = 0; i < cols; ++i)
+                {
+                    // source col becomes dest row
+                    auto dest_row = orientation == exif::Orientation::r_90 ? width_ - 1 - (tile_col + i) : tile_col + i;
+                    dest_rows[i] = std::data(transpose_buf[dest_row]);
+                }
+
+                for(std::size_t row = 0; row < rows; ++row)
+                {
+                    // source row becomes dest col
+                    auto dest_col = orientation == exif::Orientation::r_90 ? tile_row + row : height_ - 1 - (tile_row + row);
+                    for(std::size_t col = 0; col < cols; ++col)
+                        dest_rows[col][dest_col] = src_rows[row][tile_col + col];
+                }
             }
         }
 
@@ -111,18 +190,147 @@ void Image::transpose_image(exif::Orientation orientation)
 }
 
 Image Image::scale(std::size_t new_width, std::size_t new_height) const
+{
+    return Image_view{*this}.scale(new_width, new_height);
+}
+void Image::scale_region(Image & scaled, const Rect & region) const
+{
+    Image_view{*this}.scale_region(scaled, region);
+}
+
+Image_view::Image_view(const Image & img, const Image::Rect & region):
+    Image_view{Image_view{img}.sub_view(region)}
+{}
+
+Image_view Image_view::sub_view(const Image::Rect & region) const
+{
+    if(region.x + region.width > get_width() || region.y + region.height > get_height())
+        throw std::runtime_error{"Image view region out of range"};
+
+    // map back to un-rotated coordinates
+    auto raw = Image::Rect{};
+    switch(orientation_)
+    {
+    case exif::Orientation::r_0:
+        raw = region;
+        break;
+    case exif::Orientation::r_180:
+        raw = {region_.width - region.x - region.width, region_.height - region.y - region.height, region.width, region.height};
+        break;
+    case exif::Orientation::r_90:
+        raw = {region_.width - region.y - region.height, region.x, region.height, region.width};
+        break;
+    case exif::Orientation::r_270:
+        raw = {region.y, region_.height - region.x - region.width, region.height, region.width};
+        break;
+    }
+
+    return Image_view{img_, Image::Rect{region_.x + raw.x, region_.y + raw.y, raw.width, raw.height}, orientation_};
+}
+
+Image Image_view::scale(std::size_t new_width, std::size_t new_height) const
 {
     Image new_img(new_width, new_height);
+    scale_region(new_img, {0, 0, new_width, new_height});
+    return new_img;
+}
+namespace
+{
+    // reads a row of an indexed image as Colors
+    struct Palette_row
+    {
+        std::span<const std::uint8_t> indexes;
+        const std::vector<Color> & palette;
+
+        Color operator[](std::size_t i) const { return palette[indexes[i]]; }
+    };
+
+    // a row of an image rotated 180 degrees
+    template <typename Row>
+    struct Reversed_row
+    {
+        Row row;
+        std::size_t width;
+
+        Color operator[](std::size_t i) const { return row[width - 1 - i]; }
+    };
+
+    // a row of an image rotated 90 or 270 degrees, which is a column of the un-rotated image
+    template <typename Get_row>
+    struct Column_row
+    {
+        const Get_row & get_row;
+        std::size_t col;
+        std::size_t height;
+        bool bottom_up;
+
+        Color operator[](std::size_t i) const { return get_row(bottom_up ? height - 1 - i : i)[col]; }
+    };
+}
+
+void Image_view::scale_region(Image & scaled, const Image::Rect & region) const
+{
+    // rotation is done by addressing the un-rotated data in rotated order
+    auto scale_rotated = [this, &scaled, &region](const auto & get_raw_row)
+    {
+        using Get_row = std::remove_cvref_t<decltype(get_raw_row)>;
+        switch(orientation_)
+        {
+        case exif::Orientation::r_0:
+            scale_region(scaled, region, get_raw_row);
+            break;
+        case exif::Orientation::r_180:
+            scale_region(scaled, region, [this, &get_raw_row](std::size_t row)
+            {
+                return Reversed_row<decltype(get_raw_row(row))>{get_raw_row(region_.height - 1 - row), region_.width};
+            });
+            break;
+        case exif::Orientation::r_90:
+            scale_region(scaled, region, [this, &get_raw_row](std::size_t row)
+            {
+                return Column_row<Get_row>{get_raw_row, region_.width - 1 - row, region_.height, false};
+            });
+            break;
+        case exif::Orientation::r_270:
+            scale_region(scaled, region, [this, &get_raw_row](std::size_t row)
+            {
+                return Column_row<Get_row>{get_raw_row, row, region_.height, true};
+            });
+            break;
+        }
+    };
+
+    // read indexed images through their palette, so they don't get expanded
+    if(img_->is_indexed())
+    {
+        const auto & palette = img_->get_palette();
+        scale_rotated([this, &palette](std::size_t row)
+        {
+            return Palette_row{img_->index_row(region_.y + row).subspan(region_.x, region_.width), palette};
+        });
+    }
+    else
+    {
+        scale_rotated([this](std::size_t row) { return raw_row(row); });
+    }
+}
 
-    const auto px_col = static_cast<float>(width_)  / static_cast<float>(new_width);
-    const auto px_row = static_cast<float>(height_) / static_cast<float>(new_height);
+template <typename Get_row>
+void Image_view::scale_region(Image & scaled, const Image::Rect & region, Get_row get_row) const
+{
+    const auto width = get_width();
+    const auto height = get_height();
+    const auto px_col = static_cast<float>(width)  / static_cast<float>(scaled.get_width());
+    const auto px_row = static_cast<float>(height) / static_cast<float>(scaled.get_height());
 
-    float row = 0.0f;
-    for(std::size_t new_row = 0; new_row < new_height; ++new_row, row += px_row)
+    for(std::size_t new_row = region.y; new_row < region.y + region.height && new_row < scaled.get_height(); ++new_row)
     {
-        float col = 0.0f;
-        for(std::size_t new_col = 0; new_col < new_width; ++new_col, col += px_col)
+        const auto row = static_cast<float>(new_row) * px_row;
+        auto & scaled_row = scaled[new_row];
+        for(std::size_t new_col = region.x; new_col < region.x + region.width && new_col < scaled.get_width(); ++new_col)
         {
+            const auto col = static_cast<float>(new_col) * px_col;
+
             float r_sum = 0.0f;
             float g_sum = 0.0f;
             float b_sum = 0.0f;
@@ -130,16 +338,21 @@ Image Image::scale(std::size_t new_width, std::size_t new_height) const
 
             float cell_count {0.0f};
 
-            for(float y = row; y < row + px_row && y < height_; y += 1.0f)
+            for(float y = row; y < row + px_row && y < height; y += 1.0f)
             {
-                for(float x = col; x < col + px_col && x < width_; x += 1.0f)
+                auto y_ind = static_cast<std::size_t>(y);
+                if(y_ind >= height)
+                    throw std::runtime_error{"Output coords out of range"};
+
+                const auto src_row = get_row(y_ind);
+
+                for(float x = col; x < col + px_col && x < width; x += 1.0f)
                 {
                     auto x_ind = static_cast<std::size_t>(x);
-                    auto y_ind = static_cast<std::size_t>(y);
-                    if(x_ind >= width_ || y_ind >= height_)
+                    if(x_ind >= width)
                         throw std::runtime_error{"Output coords out of range"};
 
-                    auto pix = image_data_[y_ind][x_ind];
+                    auto pix = src_row[x_ind];
 
                     r_sum += static_cast<float>(pix.r) * static_cast<float>(pix.r);
                     g_sum += static_cast<float>(pix.g) * static_cast<float>(pix.g);
@@ -150,7 +363,7 @@ Image Image::scale(std::size_t new_width, std::size_t new_height) const
                 }
             }
 
-            new_img.image_data_[new_row][new_col] = Color{
+            scaled_row[new_col] = Color{
                 static_cast<unsigned char>(std::sqrt(r_sum / cell_count)),
                 static_cast<unsigned char>(std::sqrt(g_sum / cell_count)),
                 static_cast<unsigned char>(std::sqrt(b_sum / cell_count)),
@@ -158,8 +371,6 @@ Image Image::scale(std::size_t new_width, std::size_t new_height) const
             };
         }
     }
-
-    return new_img;
 }
 
 struct Octree_node // technically this would be a sedectree
@@ -390,9 +601,10 @@ std::tuple<Octree_node, std::vector<Color>, bool> octree_quantitize(const Image
 
     for(std::size_t row = 0; row < image.get_height(); ++row)
     {
+        const auto & pixels = image[row];
         for(std::size_t col = 0; col < image.get_width(); ++col)
         {
-            auto c = image[row][col];
+            auto c = pixels[col];
 
             if(gif_transparency)
             {
@@ -510,6 +722,7 @@ std::vector<Color> Image::generate_palette(std::size_t num_colors, bool gif_tran
 
 std::vector<Color> Image::generate_and_apply_palette(std::size_t num_colors, bool gif_transparency)
 {
+    image_data_.expand();
     auto octree = octree_quantitize(*this, num_colors, gif_transparency);
 
     auto & root         = std::get<0>(octree);
@@ -522,62 +735,180 @@ std::vector<Color> Image::generate_and_apply_palette(std::size_t num_colors, boo
     return std::move(palette);
 }
 
-void Image::dither(const std::function<Color(const Color &)> & palette_fun)
+void Image::dither(const std::function<Color(const Color &)> & palette_fun, const Color_map & exact_colors, Thread_pool * pool)
 {
     if(height_ < 2 || width_ < 2)
         return;
 
+    dither(palette_fun, {0, 0, width_, height_}, nullptr, nullptr, exact_colors, pool);
+}
+
+// dither only within region. Error is not diffused outside of it
+void Image::dither(const std::function<Color(const Color &)> & palette_fun, const Rect & region, const Color_map & exact_colors)
+{
+    dither(palette_fun, region, nullptr, nullptr, exact_colors);
+}
+
+// For animation frames: wherever this image is unchanged from previous, reuse
+// the result previous was dithered to, and keep error from diffusing into or
+// out of those pixels. Unchanged areas then stay stable from frame to frame
+void Image::dither(const std::function<Color(const Color &)> & palette_fun, const Rect & region, const Image & previous, const Image & previous_dithered, const Color_map & exact_colors)
+{
+    if(previous.width_ != width_ || previous.height_ != height_ || previous_dithered.width_ != width_ || previous_dithered.height_ != height_)
+        throw std::logic_error{"Previous frame size does not match for dithering"};
+
+    dither(palette_fun, region, &previous, &previous_dithered, exact_colors);
+}
+
+void Image::dither(const std::function<Color(const Color &)> & palette_fun, const Rect & region, const Image * previous, const Image * previous_dithered, const Color_map & exact_colors, Thread_pool * pool)
+{
+    const auto top = region.y, left = region.x;
+    const auto bottom = std::min(region.y + region.height, height_);
+    const auto right = std::min(region.x + region.width, width_);
+
+    if(top >= bottom || left >= right)
+        return;
+
+    const auto width = right - left;
+    if(pool && (pool->size() == 1 || bottom - top == 1))
+        pool = nullptr;
+
     // Floyd-Steinberg dithering
 
-    // keep a copy of the current and next row converted to floats for running calculations
-    std::vector<FColor> current_row(width_), next_row(width_);
-    for(std::size_t col = 0; col < width_; ++col)
+    // Rows can be dithered in parallel as a wavefront, with each row kept 3 pixels behind the row above it. By then,
+    // all error from above has arrived for the pixels being worked on, and the row above is done with them.
+    // Each row keeps its running values converted to floats in one of 2 buffers, and spreads error into the other one,
+    // loading the row below into it just ahead of use. Because of the lag, those rows only ever use the buffers
+    // ahead of (higher rows) or behind (lower rows) where this row is working
+    std::array<std::vector<FColor>, 2> float_rows {std::vector<FColor>(width), std::vector<FColor>(width)};
+    auto load_pixel = [](const Color & pixel)
     {
-        next_row[col] = image_data_[0][col];
-        if(next_row[col].a > 0.5f)
-            next_row[col].a = 1.0f;
+        FColor c = pixel;
+        if(c.a > 0.5f)
+            c.a = 1.0f;
         else
-            next_row[col] = {0.0f, 0.0f, 0.0f, 0.0f};
-    }
+            c = {0.0f, 0.0f, 0.0f, 0.0f};
+        return c;
+    };
 
-    for(std::size_t row = 0; row < height_; ++row)
+    // count of pixels done in each row, for the row below to wait on. Only published now and then, to keep these
+    // cache lines from bouncing between threads on every pixel
+    struct alignas(64) Progress { std::atomic<std::size_t> done {0}; };
+    constexpr std::size_t progress_interval = 16;
+    constexpr std::size_t lag = 3;
+    std::vector<Progress> progress(pool ? bottom - top : 0);
+
+    // rows of this image and the previous ones are looked up once per row, not for each pixel
+    struct Rows
     {
-        std::swap(next_row, current_row);
-        if(row < height_ - 1)
+        Pixel_rows::Row & pixels;
+        const Pixel_rows::Row * below; // null on the last row
+        const Pixel_rows::Row * previous;
+        const Pixel_rows::Row * previous_dithered;
+    };
+
+    auto dither_pixel = [&](std::size_t row, std::size_t col, const Rows & rows, std::vector<FColor> & current_row, std::vector<FColor> & next_row)
+    {
+        auto i = col - left;
+        auto & pixel = rows.pixels[col];
+
+        if(rows.previous && (*rows.previous)[col] == pixel)
         {
-            for(std::size_t col = 0; col < width_; ++col)
+            pixel = (*rows.previous_dithered)[col];
+            return;
+        }
+
+        if(!std::empty(exact_colors))
+        {
+            if(auto exact = exact_colors.find(pixel); exact != std::end(exact_colors))
             {
-                next_row[col] = image_data_[row + 1][col];
-                if(next_row[col].a > 0.5f)
-                    next_row[col].a = 1.0f;
-                else
-                    next_row[col] = {0.0f, 0.0f, 0.0f, 0.0f};
+                pixel = exact->second;
+                return;
             }
         }
 
-        for(std::size_t col = 0; col < width_; ++col)
+        auto old_pix = current_row[i];
+        Color new_pix = palette_fun(old_pix.clamp());
+
+        // convert back to int and store to actual pixel data
+        pixel = new_pix;
+
+        auto quant_error = old_pix - new_pix;
+
+        if(col < right - 1)
+            current_row[i + 1] += quant_error * 7.0f / 16.0f;
+        if(row < bottom - 1)
         {
-            auto old_pix = current_row[col];
-            Color new_pix = palette_fun(old_pix.clamp());
+            if(col > left)
+                next_row[i - 1] += quant_error * 3.0f / 16.0f;
 
-            // convert back to int and store to actual pixel data
-            image_data_[row][col] = new_pix;
+            next_row[i    ] += quant_error * 5.0f / 16.0f;
 
-            auto quant_error = old_pix - new_pix;
+            if(col < right - 1)
+                next_row[i + 1] += quant_error * 1.0f / 16.0f;
+        }
+    };
 
-            if(col < width_ - 1)
-                current_row[col + 1] += quant_error * 7.0f / 16.0f;
-            if(row < height_ - 1)
-            {
-                if(col > 0)
-                    next_row[col - 1] += quant_error * 3.0f / 16.0f;
+    auto dither_row = [&](std::size_t row)
+    {
+        const auto n = row - top;
+        auto & current_row = float_rows[n % 2];
+        auto & next_row = float_rows[(n + 1) % 2];
+
+        auto rows = Rows{
+            image_data_[row],
+            row < bottom - 1 ? &std::as_const(image_data_)[row + 1] : nullptr,
+            previous ? &previous->image_data_[row] : nullptr,
+            previous ? &previous_dithered->image_data_[row] : nullptr
+        };
 
-                next_row[col    ] += quant_error * 5.0f / 16.0f;
+        if(n == 0)
+        {
+            for(std::size_t col = left; col < right; ++col)
+                current_row[col - left] = load_pixel(rows.pixels[col]);
+        }
 
-                if(col < width_ - 1)
-                    next_row[col + 1] += quant_error * 1.0f / 16.0f;
+        std::size_t above_done = pool && n > 0 ? 0 : width;
+
+        for(std::size_t col = left; col < right; ++col)
+        {
+            auto i = col - left;
+
+            while(above_done < std::min(i + lag, width))
+            {
+                above_done = progress[n - 1].done.load(std::memory_order_acquire);
+                if(above_done < std::min(i + lag, width))
+                    std::this_thread::yield();
             }
+
+            if(rows.below)
+            {
+                if(i == 0)
+                    next_row[0] = load_pixel((*rows.below)[col]);
+                if(i + 1 < width)
+                    next_row[i + 1] = load_pixel((*rows.below)[col + 1]);
+            }
+
+            dither_pixel(row, col, rows, current_row, next_row);
+
+            if(pool && ((i + 1) % progress_interval == 0 || i + 1 == width))
+                progress[n].done.store(i + 1, std::memory_order_release);
         }
+    };
+
+    if(pool)
+    {
+        // getting rows expanded or un-shared isn't thread safe, so do it all up front
+        image_data_.expand();
+        for(auto row = top; row < bottom; ++row)
+            image_data_[row];
+
+        pool->parallel_for(bottom - top, [&dither_row, top](std::size_t n) { dither_row(top + n); });
+    }
+    else
+    {
+        for(auto row = top; row < bottom; ++row)
+            dither_row(row);
     }
 }
 
@@ -587,10 +918,24 @@ void Image::open(std::istream &, const Args &)
 }
 void Image::convert(const Args & args) const
 {
+    if(orientation_ != exif::Orientation::r_0)
+    {
+        // writers expect upright pixel data
+        Image rotated;
+        rotated.copy_image_data(*this);
+        rotated.transpose_image(orientation_);
+        rotated.set_orientation(exif::Orientation::r_0);
+        rotated.convert(args);
+        return;
+    }
+
     std::ofstream out{args.convert_filename->first, std::ios_base::binary};
     if(!out)
         throw std::runtime_error {"Could not open " + args.convert_filename->first + " for writing: " + std::strerror(errno)};
 
+    // writers read rows as Colors
+    make_resident();
+
     auto & ext = args.convert_filename->second;
 
     if(false); // dummy statement so we don't have weirdness with all of the #ifdefs below
@@ -684,7 +1029,8 @@ bool Image::supports_animation() const { return false; }
 
 std::size_t Image::num_images() const
 {
-    return this_is_first_image_ ? std::size(images_) + 1u : std::size(images_);
+    auto stored = std::empty(image_index_) ? std::size(images_) : std::size(image_index_);
+    return this_is_first_image_ ? stored + 1u : stored;
 }
 
 std::size_t Image::num_frames() const
@@ -703,10 +1049,10 @@ const Image & Image::get_image(std::size_t image_no) const
         if(image_no == 0u)
             return *this;
         else
-            return images_[image_no - 1];
+            return stored_image(image_no - 1);
     }
     else
-        return images_[image_no];
+        return stored_image(image_no);
 }
 const Image & Image::get_frame(std::size_t frame_no) const
 {
@@ -721,6 +1067,227 @@ std::chrono::duration<float> Image::get_frame_delay(std::size_t frame_no) const
     return frame_delays_[frame_no];
 }
 
+const Image & Image::stored_image(std::size_t index) const
+{
+    if(!std::empty(image_index_))
+        index = image_index_[index];
+
+    use_stored_image(index);
+    return images_[index];
+}
+
+// mark an entry of images_ as most recently used, and spill the least
+// recently used entries to file until the rest fit in the memory limit. The
+// most recently used is always kept, and spilled entries are read back in
+// when next accessed.
+// Entries that share rows (like composed animation frames do) are charged an
+// even share of each, so spilling one may free less than it's charged, but
+// spilling the others sharing its rows frees the rest. Charges are counted
+// when an entry stops being the most recently used, so each use costs one
+// pass over that entry's rows, rather than over every resident entry
+void Image::use_stored_image(std::size_t index) const
+{
+    if(!memory_limit_ || last_used_image_ == index)
+        return;
+
+    if(auto size = resident_sizes_.find(index); size != std::end(resident_sizes_))
+    {
+        resident_size_ -= size->second;
+        resident_sizes_.erase(size);
+        spillable_images_.erase(index);
+    }
+
+    if(last_used_image_)
+        track_stored_image(*last_used_image_);
+    last_used_image_ = index;
+
+    // the entry in use counts at full size, as it's either resident already, or about to be read back in
+    auto & used = images_[index];
+    auto reserved = used.width_ * used.height_ * sizeof(Color);
+
+    while(!spillable_images_.empty() && resident_size_ + reserved > *memory_limit_)
+    {
+        auto lru = spillable_images_.back();
+        spillable_images_.pop_back();
+
+        if(!spill_file_)
+            spill_file_ = std::make_shared<Spill_file>();
+
+        images_[lru].image_data_.spill(spill_file_);
+        resident_size_ -= resident_sizes_[lru];
+        resident_sizes_.erase(lru);
+    }
+}
+
+// charge a resident entry of images_ for its share of the memory it uses
+void Image::track_stored_image(std::size_t index) const
+{
+    if(index >= std::size(images_) || images_[index].image_data_.is_spilled())
+        return;
+
+    auto & img = images_[index];
+    auto size = img.image_data_.memory_share();
+    resident_sizes_[index] = size;
+    resident_size_ += size;
+
+    // indexed data is already compact, and isn't spilled
+    if(!img.image_data_.is_indexed())
+        spillable_images_.touch(index);
+}
+
+void Image::stop_tracking_stored_images() const
+{
+    last_used_image_.reset();
+    spillable_images_.clear();
+    resident_sizes_.clear();
+    resident_size_ = 0;
+}
+
+namespace
+{
+    // fast hash of the pixel data, a 64-bit word at a time. Indexed data is hashed as its indexes, so it isn't
+    // expanded, and only matches other indexed data
+    std::uint64_t hash_image_data(const Image & img)
+    {
+        constexpr std::uint64_t mul1 = 0x9E3779B97F4A7C15ull;
+        constexpr std::uint64_t mul2 = 0xC2B2AE3D27D4EB4Full;
+
+        auto h = (static_cast<std::uint64_t>(img.get_width()) << 32 | img.get_height() | static_cast<std::uint64_t>(img.is_indexed()) << 63) * mul1;
+
+        auto hash_bytes = [&h](const char * data, std::size_t len)
+        {
+            std::size_t i = 0;
+            for(; i + sizeof(std::uint64_t) <= len; i += sizeof(std::uint64_t))
+            {
+                std::uint64_t word;
+                std::memcpy(&word, data + i, sizeof(word));
+                h = std::rotl(h ^ (word * mul1), 31) * mul2;
+            }
+            for(; i < len; ++i)
+                h = std::rotl(h ^ (static_cast<unsigned char>(data[i]) * mul1), 31) * mul2;
+        };
+
+        for(std::size_t row = 0; row < img.get_height(); ++row)
+        {
+            if(img.is_indexed())
+                hash_bytes(reinterpret_cast<const char *>(std::data(img.index_row(row))), img.get_width());
+            else
+                hash_bytes(img.row_buffer(row), img.get_width() * sizeof(Color));
+        }
+
+        return h ^ (h >> 29);
+    }
+
+    bool same_image_data(const Image & a, const Image & b)
+    {
+        if(a.get_width() != b.get_width() || a.get_height() != b.get_height() || a.is_indexed() != b.is_indexed())
+            return false;
+
+        if(a.is_indexed())
+        {
+            if(a.get_palette() != b.get_palette())
+                return false;
+            for(std::size_t row = 0; row < a.get_height(); ++row)
+            {
+                if(!std::ranges::equal(a.index_row(row), b.index_row(row)))
+                    return false;
+            }
+            return true;
+        }
+
+        for(std::size_t row = 0; row < a.get_height(); ++row)
+        {
+            if(a[row] != b[row])
+                return false;
+        }
+        return true;
+    }
+}
+
+// Find identical frames. When merge_consecutive is set, runs of identical
+// frames are collapsed into one frame with their delays summed (this changes
+// frame numbering, so only do it for animation). Any remaining identical
+// frames share a single copy in images_
+void Image::deduplicate_frames(bool merge_consecutive)
+{
+    // frames may have moved in images_, so start tracking use over again
+    stop_tracking_stored_images();
+    if(spill_file_)
+    {
+        // comparing frames would read all spilled frames back in, so skip it
+        for(std::size_t i = 0; i < std::size(images_); ++i)
+            track_stored_image(i);
+        return;
+    }
+
+    const std::size_t offset = this_is_first_image_ ? 1u : 0u;
+
+    std::vector<std::uint64_t> hashes(std::size(images_));
+    for(std::size_t i = 0; i < std::size(images_); ++i)
+        hashes[i] = hash_image_data(images_[i]);
+
+    if(merge_consecutive && std::size(frame_delays_) == num_images())
+    {
+        std::vector<Image> merged_images;
+        std::vector<std::uint64_t> merged_hashes;
+        std::vector<std::chrono::duration<float>> merged_delays(std::begin(frame_delays_), std::begin(frame_delays_) + offset);
+
+        for(std::size_t i = 0; i < std::size(images_); ++i)
+        {
+            const Image * prev = nullptr;
+            if(!std::empty(merged_images))
+                prev = &merged_images.back();
+            else if(this_is_first_image_)
+                prev = this;
+
+            if(prev && (std::empty(merged_hashes) || merged_hashes.back() == hashes[i]) && same_image_data(*prev, images_[i]))
+            {
+                merged_delays.back() += frame_delays_[i + offset];
+                continue;
+            }
+
+            merged_images.emplace_back(std::move(images_[i]));
+            merged_hashes.emplace_back(hashes[i]);
+            merged_delays.emplace_back(frame_delays_[i + offset]);
+        }
+
+        images_ = std::move(merged_images);
+        hashes = std::move(merged_hashes);
+        frame_delays_ = std::move(merged_delays);
+    }
+
+    std::vector<Image> unique_images;
+    std::vector<std::size_t> index(std::size(images_));
+    std::unordered_multimap<std::uint64_t, std::size_t> unique_hashes;
+    bool found_duplicate = false;
+
+    for(std::size_t i = 0; i < std::size(images_); ++i)
+    {
+        auto [begin, end] = unique_hashes.equal_range(hashes[i]);
+        auto match = std::find_if(begin, end, [this, i, &unique_images](auto && entry) { return same_image_data(unique_images[entry.second], images_[i]); });
+
+        if(match != end)
+        {
+            // a shared frame follows different frames, so what changed from the previous frame isn't known anymore
+            unique_images[match->second].set_dirty_rect({});
+            index[i] = match->second;
+            found_duplicate = true;
+        }
+        else
+        {
+            index[i] = std::size(unique_images);
+            unique_hashes.emplace(hashes[i], index[i]);
+            unique_images.emplace_back(std::move(images_[i]));
+        }
+    }
+
+    images_ = std::move(unique_images);
+    if(found_duplicate)
+        image_index_ = std::move(index);
+    else
+        image_index_.clear();
+}
+
 char * Image::row_buffer(std::size_t row)
 {
     return reinterpret_cast<char *>(std::data(image_data_[row]));
@@ -731,46 +1298,82 @@ const char * Image::row_buffer(std::size_t row) const
     return reinterpret_cast<const char *>(std::data(image_data_[row]));
 }
 
+void Image::import_rows(const void * data, std::size_t stride, Pixel_format format, std::size_t first_row, std::size_t num_rows)
+{
+    num_rows = std::min(num_rows, height_ - std::min(first_row, height_));
+    auto src = static_cast<const unsigned char *>(data);
+    for(std::size_t row = 0; row < num_rows; ++row)
+        import_row(src + row * stride, std::data(image_data_[first_row + row]), width_, format);
+}
+
+void Image::export_rows(void * data, std::size_t stride, Pixel_format format, bool invert, std::size_t first_row, std::size_t num_rows) const
+{
+    num_rows = std::min(num_rows, height_ - std::min(first_row, height_));
+    auto dest = static_cast<unsigned char *>(data);
+    for(std::size_t row = 0; row < num_rows; ++row)
+        export_row(std::data(image_data_[first_row + row]), dest + row * stride, width_, format, invert);
+}
+
 void Image::swap_image_data(Image & other)
 {
     std::swap(width_, other.width_);
     std::swap(height_, other.height_);
     std::swap(image_data_, other.image_data_);
+    std::swap(source_palette_, other.source_palette_);
+    std::swap(orientation_, other.orientation_);
 }
 void Image::copy_image_data(const Image & other)
 {
     width_ = other.width_;
     height_ = other.height_;
     image_data_ = other.image_data_;
+    source_palette_ = other.source_palette_;
+    orientation_ = other.orientation_;
 }
 void Image::move_image_data(Image & other)
 {
     width_ = other.width_;
     height_ = other.height_;
     image_data_ = std::move(other.image_data_);
+    source_palette_ = std::move(other.source_palette_);
+    orientation_ = other.orientation_;
 
     other.image_data_.clear();
+    other.source_palette_.clear();
     other.width_ = 0;
     other.height_ = 0;
 }
 
+[[nodiscard]] std::unique_ptr<Input_source> open_input(const Args & args)
+{
+    // maps regular files, so codecs that need all of the data at once can use it without a copy
+    auto source = args.input_filename == "-" ? std::make_unique<Input_source>(std::cin) : std::make_unique<Input_source>(args.input_filename);
+
+    if(!source->is_open())
+        throw std::runtime_error{"Could not open input file " + (args.input_filename == "-" ? "" : ("(" + args.input_filename + ") ")) + ": " + std::string{std::strerror(errno)}};
+
+    return source;
+}
+
 [[nodiscard]] std::unique_ptr<Image> get_image_data(const Args & args)
+{
+    auto source = open_input(args);
+    return get_image_data(args, *source);
+}
+
+[[nodiscard]] std::unique_ptr<Image> get_image_data(const Args & args, Input_source & source)
 {
     std::string extension;
-    std::ifstream input_file;
     if(args.input_filename != "-")
     {
-        input_file.open(args.input_filename, std::ios_base::in | std::ios_base::binary);
         auto pos = args.input_filename.find_last_of('.');
         if(pos != std::string::npos)
             extension = args.input_filename.substr(pos);
         for(auto && i: extension)
             i = std::tolower(i);
     }
-    std::istream & input = args.input_filename == "-" ? std::cin : input_file;
 
-    if(!input)
-        throw std::runtime_error{"Could not open input file " + (args.input_filename == "-" ? "" : ("(" + args.input_filename + ") ")) + ": " + std::string{std::strerror(errno)}};
+    std::istream input{&source};
 
     Image::Header header;
 
@@ -781,10 +1384,9 @@ void Image::move_image_data(Image & other)
     else if(!input)
         throw std::runtime_error{"Could not read input file " + (args.input_filename == "-" ? "" : ("(" + args.input_filename + ") ")) + ": " + std::string{std::strerror(errno)}};
 
-    // rewind (seekg(0) not always supported for pipes)
-    for(auto i = std::rbegin(header); i != std::rend(header); ++i)
-        input.putback(*i);
-    if(input.bad())
+    // rewind. Input_source can seek on pipes too
+    input.seekg(0);
+    if(!input)
         throw std::runtime_error{"Unable to rewind stream"};
 
     std::unique_ptr<Image> img;
@@ -895,6 +1497,10 @@ void Image::move_image_data(Image & other)
         {
             img = std::make_unique<MotoLogo>();
         }
+        else if(is_pixel_cache(header))
+        {
+            img = std::make_unique<Pixel_cache>();
+        }
         else if(is_png(header))
         {
             #ifdef PNG_FOUND
@@ -6,11 +6,20 @@
 #include <functional>
 #include <istream>
 #include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
 #include <vector>
 
 #include "../args.hpp"
 #include "../color.hpp"
 #include "exif.hpp"
+#include "input_source.hpp"
+#include "lru_list.hpp"
+#include "pixel_format.hpp"
+#include "pixel_rows.hpp"
+
+class Thread_pool;
 
 struct Early_exit: public std::exception
 {
@@ -26,6 +35,11 @@ public:
     Image() = default;
     Image(std::size_t w, std::size_t h) { set_size(w, h); }
 
+    struct Rect
+    {
+        std::size_t x{0}, y{0}, width{0}, height{0};
+    };
+
     virtual ~Image() = default;
     Image(const Image &) = default;
     Image & operator=(const Image &) = default;
@@ -43,18 +57,54 @@ public:
     std::size_t get_width() const { return width_; }
     std::size_t get_height() const { return height_; }
     void set_size(std::size_t w, std::size_t h);
+    // 1 byte per pixel storage, expanded to Colors by make_resident or on first non-const access to the pixels
+    void set_size(std::size_t w, std::size_t h, const std::vector<Color> & palette);
+    bool is_indexed() const { return image_data_.is_indexed(); }
+    std::span<const std::uint8_t> index_row(std::size_t row) const { return image_data_.index_row(row); }
+    std::span<std::uint8_t> index_row(std::size_t row) { return image_data_.index_row(row); }
+    const std::vector<Color> & get_palette() const { return image_data_.palette(); }
+    // read spilled pixel data back into memory, and unless keep_indexed is set, expand indexed data to Colors. Rows
+    // can only be read once this is done, as reading them doesn't do it. Not thread safe, so call it before sharing
+    // the image between threads
+    void make_resident(bool keep_indexed = false) const { keep_indexed ? image_data_.unspill() : image_data_.expand(); }
+    bool is_resident() const { return !image_data_.is_spilled(); }
+
+    // colors the image was made from, if known (ie. the palette of a paletted source). May be incomplete
+    const std::vector<Color> & get_source_palette() const { return source_palette_; }
+    void set_source_palette(std::vector<Color> palette) { source_palette_ = std::move(palette); }
+
+    // limit on decoded pixel data, in bytes. Images larger than this fail to load, unless the codec can decode at
+    // reduced resolution. Animation frames over the limit are spilled to a temp file
+    static void set_memory_limit(std::optional<std::size_t> limit) { memory_limit_ = limit; }
+    static const std::optional<std::size_t> & get_memory_limit() { return memory_limit_; }
+    static bool fits_memory_limit(std::size_t w, std::size_t h, std::size_t bytes_per_pixel = sizeof(Color));
 
     using Header = std::array<char, max_header_len>;
     static bool header_cmp(unsigned char a, char b);
-    static std::vector<unsigned char> read_input_to_memory(std::istream & input);
+    // read the rest of input. Memory mapped input is viewed in place, without copying
+    static Input_data read_input_to_memory(std::istream & input);
 
     Image scale(std::size_t new_width, std::size_t new_height) const;
+    void scale_region(Image & scaled, const Rect & region) const;
     void transpose_image(exif::Orientation orientation);
 
+    // orientation to apply when displaying or converting. Pixel data is left un-rotated
+    exif::Orientation get_orientation() const { return orientation_; }
+    void set_orientation(exif::Orientation orientation) { orientation_ = orientation; }
+
     std::vector<Color> generate_palette(std::size_t num_colors, bool gif_transparency = false) const;
     std::vector<Color> generate_and_apply_palette(std::size_t num_colors, bool gif_transparency = false);
-    void dither(const std::function<Color(const Color &)> & palette_fun);
-    template <typename Iter> void dither(Iter palette_start, Iter palette_end);
+
+    // pixels exactly matching a key are set to its value without dithering, and don't spread or take any error
+    using Color_map = std::unordered_map<Color, Color>;
+
+    // with a pool, rows are dithered in parallel. The result is the same either way
+    void dither(const std::function<Color(const Color &)> & palette_fun, const Color_map & exact_colors = {}, Thread_pool * pool = nullptr);
+    void dither(const std::function<Color(const Color &)> & palette_fun, const Rect & region, const Color_map & exact_colors = {});
+    void dither(const std::function<Color(const Color &)> & palette_fun, const Rect & region, const Image & previous, const Image & previous_dithered, const Color_map & exact_colors = {});
+    template <typename Iter> void dither(Iter palette_start, Iter palette_end, const Color_map & exact_colors = {}, Thread_pool * pool = nullptr);
+    template <typename Iter> void dither(Iter palette_start, Iter palette_end, const Rect & region, const Color_map & exact_colors = {});
+    template <typename Iter> void dither(Iter palette_start, Iter palette_end, const Rect & region, const Image & previous, const Image & previous_dithered, const Color_map & exact_colors = {});
 
     virtual void open(std::istream & input, const Args & args);
     void convert(const Args & args) const;
@@ -70,29 +120,126 @@ public:
     virtual const Image & get_frame(std::size_t frame_no) const;
     virtual std::chrono::duration<float> get_frame_delay(std::size_t image_no) const;
 
+    // for animation frames, the area that changed since the previous frame. Empty if unknown
+    const std::optional<Rect> & get_dirty_rect() const { return dirty_rect_; }
+    void set_dirty_rect(const std::optional<Rect> & rect) { dirty_rect_ = rect; }
+
     char * row_buffer(std::size_t row);
     const char * row_buffer(std::size_t row) const;
 
+    // copy rows of pixel data in from / out to a buffer in another layout. stride is the distance between rows in
+    // bytes. By default, all rows from first_row to the bottom of the image are copied
+    static constexpr std::size_t all_rows = static_cast<std::size_t>(-1);
+    void import_rows(const void * data, std::size_t stride, Pixel_format format, std::size_t first_row = 0, std::size_t num_rows = all_rows);
+    void export_rows(void * data, std::size_t stride, Pixel_format format, bool invert = false, std::size_t first_row = 0, std::size_t num_rows = all_rows) const;
+
     void swap_image_data(Image & other);
     void copy_image_data(const Image & other);
     void move_image_data(Image & other);
 
 protected:
+    void dither(const std::function<Color(const Color &)> & palette_fun, const Rect & region, const Image * previous, const Image * previous_dithered, const Color_map & exact_colors, Thread_pool * pool = nullptr);
+    void deduplicate_frames(bool merge_consecutive);
+    const Image & stored_image(std::size_t index) const;
+    void use_stored_image(std::size_t index) const;
 
     std::size_t width_{0};
     std::size_t height_{0};
-    std::vector<std::vector<Color>> image_data_;
+    Pixel_rows image_data_;
+    std::optional<Rect> dirty_rect_;
+    std::vector<Color> source_palette_;
+    exif::Orientation orientation_ {exif::Orientation::r_0};
 
     bool this_is_first_image_ {true};
     std::vector<Image> images_;
+    std::vector<std::size_t> image_index_; // maps to (possibly shared) entries in images_. Empty if images_ is in order
     std::vector<std::chrono::duration<float>> frame_delays_;
     std::chrono::duration<float> default_frame_delay_ {std::chrono::milliseconds{25}};
+
+private:
+    inline static std::optional<std::size_t> memory_limit_;
+
+    // tracking of entries in images_ against the memory limit, by index
+    void stop_tracking_stored_images() const;
+    void track_stored_image(std::size_t index) const;
+    mutable std::optional<std::size_t> last_used_image_;                // not charged, as it's always kept
+    mutable Lru_list<std::size_t> spillable_images_;                    // charged entries that can be spilled
+    mutable std::unordered_map<std::size_t, std::size_t> resident_sizes_; // bytes charged to each resident entry
+    mutable std::size_t resident_size_ {0};                            // total of resident_sizes_
+    mutable std::shared_ptr<Spill_file> spill_file_;
 };
 
+// Non-owning, read-only view of a rectangular region of an Image. The Image must outlive the view
+// The view has the Image's orientation applied, so sizes and regions are in rotated coordinates. Scaling reads the
+// un-rotated pixel data directly, so the full size image never needs to be rotated for display
+class Image_view
+{
+public:
+    Image_view(const Image & img): Image_view{&img, {0, 0, img.get_width(), img.get_height()}, img.get_orientation()} {}
+    Image_view(const Image & img, const Image::Rect & region);
+
+    std::size_t get_width() const { return is_transposed() ? region_.height : region_.width; }
+    std::size_t get_height() const { return is_transposed() ? region_.width : region_.height; }
+    const std::vector<Color> & get_source_palette() const { return img_->get_source_palette(); }
+
+    // region is relative to this view
+    Image_view sub_view(const Image::Rect & region) const;
+
+    Image scale(std::size_t new_width, std::size_t new_height) const;
+    // may be called from several threads at once for separate regions of scaled, once the source is resident
+    void scale_region(Image & scaled, const Image::Rect & region) const;
+    // the scaler reads indexed data as it is
+    void make_resident() const { img_->make_resident(true); }
+
+private:
+    Image_view(const Image * img, const Image::Rect & region, exif::Orientation orientation): img_{img}, region_{region}, orientation_{orientation} {}
+
+    bool is_transposed() const { return orientation_ == exif::Orientation::r_90 || orientation_ == exif::Orientation::r_270; }
+    // un-rotated row, relative to region_
+    std::span<const Color> raw_row(std::size_t row) const
+    {
+        return std::span{(*img_)[region_.y + row]}.subspan(region_.x, region_.width);
+    }
+
+    template <typename Get_row> void scale_region(Image & scaled, const Image::Rect & region, Get_row get_row) const;
+
+    const Image * img_;
+    Image::Rect region_; // in un-rotated coordinates
+    exif::Orientation orientation_;
+};
+
+// args.input_filename, or stdin for -
+[[nodiscard]] std::unique_ptr<Input_source> open_input(const Args & args);
 [[nodiscard]] std::unique_ptr<Image> get_image_data(const Args & args);
+// as above, reading from source, which must be at the start of the input
+[[nodiscard]] std::unique_ptr<Image> get_image_data(const Args & args, Input_source & source);
+
+template <typename Iter>
+void Image::dither(Iter palette_start, Iter palette_end, const Color_map & exact_colors, Thread_pool * pool)
+{
+    dither([palette_start, palette_end](const Color & c)
+    {
+        return *std::min_element(palette_start, palette_end, [c](const Color & a, const Color & b)
+        {
+            return color_dist2(a, c) < color_dist2(b, c);
+        });
+    }, exact_colors, pool);
+}
+
+template <typename Iter>
+void Image::dither(Iter palette_start, Iter palette_end, const Rect & region, const Color_map & exact_colors)
+{
+    dither([palette_start, palette_end](const Color & c)
+    {
+        return *std::min_element(palette_start, palette_end, [c](const Color & a, const Color & b)
+        {
+            return color_dist2(a, c) < color_dist2(b, c);
+        });
+    }, region, exact_colors);
+}
 
 template <typename Iter>
-void Image::dither(Iter palette_start, Iter palette_end)
+void Image::dither(Iter palette_start, Iter palette_end, const Rect & region, const Image & previous, const Image & previous_dithered, const Color_map & exact_colors)
 {
     dither([palette_start, palette_end](const Color & c)
     {
@@ -100,7 +247,7 @@ void Image::dither(Iter palette_start, Iter palette_end)
         {
             return color_dist2(a, c) < color_dist2(b, c);
         });
-    });
+    }, region, previous, previous_dithered, exact_colors);
 }
 
 #endif // IMAGE_HPP
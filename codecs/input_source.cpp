@@ -0,0 +1,291 @@
+#include "input_source.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "config.h"
+
+#ifdef HAS_MMAN
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // big enough that small inputs never need to be spooled
+    constexpr std::size_t window_size = 64 * 1024;
+}
+
+Input_source::Input_source(const std::string & path)
+{
+#ifdef HAS_MMAN
+    if(auto fd = ::open(path.c_str(), O_RDONLY); fd >= 0)
+    {
+        struct stat info;
+        if(fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+        {
+            if(auto map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0); map != MAP_FAILED)
+            {
+                map_ = static_cast<char *>(map);
+                map_size_ = info.st_size;
+
+                // most codecs read straight through
+                madvise(map, map_size_, MADV_SEQUENTIAL);
+
+                // the stream never writes to its get area, so the mapping can stay read-only
+                setg(map_, map_, map_ + map_size_);
+            }
+        }
+
+        // the mapping stays valid after closing
+        ::close(fd);
+    }
+
+    if(map_)
+        return;
+#endif
+
+    // not a regular file, or can't be mapped. Read it as a stream
+    file_.open(path, std::ios_base::in | std::ios_base::binary);
+    if(!file_)
+        return;
+
+    stream_ = &file_;
+    window_.resize(window_size);
+    set_window(0, 0);
+}
+
+Input_source::Input_source(std::istream & input):
+    stream_{&input},
+    window_(window_size)
+{
+    set_window(0, 0);
+}
+
+Input_source::~Input_source()
+{
+#ifdef HAS_MMAN
+    if(map_)
+        munmap(map_, map_size_);
+    if(spool_map_)
+        munmap(spool_map_, spooled_);
+#endif
+    if(spool_)
+        std::fclose(spool_);
+}
+
+std::size_t Input_source::size()
+{
+    if(map_)
+        return map_size_;
+
+    // avoid spooling if the rest fits in the window
+    fill_window();
+    if(!stream_end_)
+    {
+        auto pos = position();
+        spool_window();
+        read_stream_to(std::numeric_limits<std::size_t>::max());
+        set_window(pos, 0);
+    }
+
+    return stream_read_;
+}
+
+std::span<const unsigned char> Input_source::contents()
+{
+    if(map_)
+        return {reinterpret_cast<const unsigned char *>(map_), map_size_};
+
+    auto total = size();
+
+    // never outgrew the window
+    if(spooled_ == 0 && window_pos_ == 0)
+        return {reinterpret_cast<const unsigned char *>(std::data(window_)), total};
+
+    spool_window();
+    if(spool_map_)
+        return {reinterpret_cast<const unsigned char *>(spool_map_), spooled_};
+
+    if(std::fflush(spool_) != 0)
+        throw std::runtime_error{"Could not write input to temp file"};
+
+#ifdef HAS_MMAN
+    if(auto map = mmap(nullptr, spooled_, PROT_READ, MAP_PRIVATE, fileno(spool_), 0); map != MAP_FAILED)
+    {
+        spool_map_ = static_cast<char *>(map);
+        return {reinterpret_cast<const unsigned char *>(spool_map_), spooled_};
+    }
+#endif
+
+    if(std::empty(spool_copy_))
+    {
+        spool_copy_.resize(spooled_);
+        if(std::fseek(spool_, 0, SEEK_SET) != 0 || std::fread(std::data(spool_copy_), 1, spooled_, spool_) != spooled_)
+            throw std::runtime_error{"Could not read input from temp file"};
+    }
+    return {reinterpret_cast<const unsigned char *>(std::data(spool_copy_)), spooled_};
+}
+
+std::span<const unsigned char> Input_source::read_remaining()
+{
+    auto pos = position();
+    auto all = contents();
+    pubseekoff(0, std::ios_base::end, std::ios_base::in);
+    return all.subspan(std::min(pos, std::size(all)));
+}
+
+std::span<const unsigned char> Input_source::read_block()
+{
+    if(gptr() == egptr())
+        underflow();
+
+    std::span<const unsigned char> block {reinterpret_cast<const unsigned char *>(gptr()), reinterpret_cast<const unsigned char *>(egptr())};
+    setg(eback(), egptr(), egptr());
+    return block;
+}
+
+Input_source::int_type Input_source::underflow()
+{
+    if(gptr() != egptr())
+        return traits_type::to_int_type(*gptr());
+
+    if(!stream_)
+        return traits_type::eof();
+
+    // the window always ends at the current position here
+    auto pos = position();
+    if(pos < spooled_)
+    {
+        // seeked back to before the window. Reload from the spool file
+        auto count = std::min(std::size(window_), spooled_ - pos);
+        if(std::fseek(spool_, static_cast<long>(pos), SEEK_SET) != 0 || std::fread(std::data(window_), 1, count, spool_) != count)
+            throw std::runtime_error{"Could not read input from temp file"};
+        set_window(pos, count);
+    }
+    else
+    {
+        // reading new input
+        if(pos - window_pos_ == std::size(window_))
+        {
+            spool_window();
+            set_window(pos, 0);
+        }
+        fill_window();
+    }
+
+    return gptr() == egptr() ? traits_type::eof() : traits_type::to_int_type(*gptr());
+}
+
+Input_source::pos_type Input_source::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    auto base = dir == std::ios_base::beg ? std::size_t{0} : dir == std::ios_base::cur ? position() : size();
+    return seekpos(static_cast<off_type>(base) + off, which);
+}
+
+Input_source::pos_type Input_source::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    if(!(which & std::ios_base::in) || pos < 0 || !is_open())
+        return pos_type(off_type(-1));
+
+    auto target = static_cast<std::size_t>(pos);
+
+    if(target >= window_pos_ && target <= window_end())
+    {
+        setg(eback(), eback() + (target - window_pos_), egptr());
+        return pos;
+    }
+
+    if(map_)
+        return pos_type(off_type(-1));
+
+    // moving the window. Skipped-over input still needs to be spooled, so seeking back to it works
+    auto current = position();
+    spool_window();
+    if(target > stream_read_)
+        read_stream_to(target);
+
+    if(target > stream_read_)
+    {
+        set_window(current, 0);
+        return pos_type(off_type(-1));
+    }
+
+    set_window(target, 0);
+    return pos;
+}
+
+void Input_source::set_window(std::size_t pos, std::size_t size)
+{
+    window_pos_ = pos;
+    setg(std::data(window_), std::data(window_), std::data(window_) + size);
+}
+
+void Input_source::fill_window()
+{
+    if(stream_end_ || window_end() != stream_read_)
+        return;
+
+    auto used = window_end() - window_pos_;
+    auto wanted = std::size(window_) - used;
+    if(wanted == 0)
+        return;
+
+    stream_->read(std::data(window_) + used, wanted);
+    if(stream_->bad())
+        throw std::runtime_error{"Error reading input file"};
+
+    auto count = static_cast<std::size_t>(stream_->gcount());
+    if(count < wanted)
+        stream_end_ = true;
+
+    stream_read_ += count;
+    setg(eback(), gptr(), egptr() + count);
+}
+
+void Input_source::spool_window()
+{
+    // input not yet spooled is always at the end of the window
+    if(spooled_ < stream_read_)
+        spool_write(std::data(window_) + (spooled_ - window_pos_), stream_read_ - spooled_);
+}
+
+void Input_source::read_stream_to(std::size_t end)
+{
+    // uses the window as a buffer, so it must be spooled first
+    while(stream_read_ < end && !stream_end_)
+    {
+        auto wanted = std::min(std::size(window_), end - stream_read_);
+        stream_->read(std::data(window_), wanted);
+        if(stream_->bad())
+            throw std::runtime_error{"Error reading input file"};
+
+        auto count = static_cast<std::size_t>(stream_->gcount());
+        if(count < wanted)
+            stream_end_ = true;
+
+        stream_read_ += count;
+        spool_write(std::data(window_), count);
+    }
+}
+
+void Input_source::spool_write(const char * data, std::size_t size)
+{
+    if(size == 0)
+        return;
+
+    if(!spool_)
+    {
+        spool_ = std::tmpfile();
+        if(!spool_)
+            throw std::runtime_error{"Could not create temp file to buffer input"};
+    }
+
+    if(std::fseek(spool_, 0, SEEK_END) != 0 || std::fwrite(data, 1, size, spool_) != size)
+        throw std::runtime_error{"Could not write input to temp file"};
+
+    spooled_ += size;
+}
@@ -0,0 +1,112 @@
+#ifndef INPUT_SOURCE_HPP
+#define INPUT_SOURCE_HPP
+
+#include <fstream>
+#include <istream>
+#include <span>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdio>
+
+// Seekable input, readable as a stream. Regular files are memory mapped, and
+// read in place. Anything else (pipes, stdin) is read through a small window.
+// Once the input outgrows the window, what's been read is also spooled to a
+// temp file, so it can be seeked back to without keeping it all in memory.
+// Codecs that need all of the input at once can get it through contents() or
+// Image::read_input_to_memory: free for mapped files, and for spooled input,
+// the spool file is mapped instead
+class Input_source: public std::streambuf
+{
+public:
+    // leaves is_open() false if the file can't be opened, like std::ifstream
+    explicit Input_source(const std::string & path);
+    // reads from input, which must outlive this
+    explicit Input_source(std::istream & input);
+    ~Input_source();
+    Input_source(const Input_source &) = delete;
+    Input_source & operator=(const Input_source &) = delete;
+    Input_source(Input_source &&) = delete;
+    Input_source & operator=(Input_source &&) = delete;
+
+    bool is_open() const { return map_ || stream_; }
+
+    // total size. For streams, this reads the rest of the input
+    std::size_t size();
+
+    // the whole input, in memory. Valid until this is destroyed
+    std::span<const unsigned char> contents();
+    // the rest of the input from the current position, in memory, and advance to the end. Valid until this is destroyed
+    std::span<const unsigned char> read_remaining();
+    // the input after the current position that's already in memory, reading more if none is, and advance past it.
+    // Empty at the end of input. Valid until the next read or seek
+    std::span<const unsigned char> read_block();
+
+protected:
+    int_type underflow() override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+private:
+    std::size_t position() const { return window_pos_ + (gptr() - eback()); }
+    std::size_t window_end() const { return window_pos_ + (egptr() - eback()); }
+    void set_window(std::size_t pos, std::size_t size);
+    // read from stream_ into the rest of the window, if the window ends at the newest input
+    void fill_window();
+    // write any of the window not yet spooled to the spool file. Needed before the window moves
+    void spool_window();
+    // read stream_ up to end, straight into the spool file
+    void read_stream_to(std::size_t end);
+    void spool_write(const char * data, std::size_t size);
+
+    // memory mapped file
+    char * map_ {nullptr};
+    std::size_t map_size_ {0};
+
+    // streamed input
+    std::ifstream file_;
+    std::istream * stream_ {nullptr};
+    bool stream_end_ {false};
+    std::size_t stream_read_ {0}; // bytes read from stream_
+    std::vector<char> window_;
+    std::size_t window_pos_ {0};  // input position of the start of the window
+
+    // input before spooled_ is in the spool file. Anything read after that is in the window
+    std::FILE * spool_ {nullptr};
+    std::size_t spooled_ {0};
+    char * spool_map_ {nullptr};   // spool file mapped by contents()
+    std::vector<char> spool_copy_; // stands in for spool_map_ without mmap
+};
+
+// The whole of an input, in memory. Either owns a buffer the input was read
+// into, or views memory owned by something else, like an Input_source
+class Input_data
+{
+public:
+    Input_data() = default;
+    explicit Input_data(std::vector<unsigned char> buffer): buffer_{std::move(buffer)}, view_{buffer_} {}
+    explicit Input_data(std::span<const unsigned char> view): view_{view} {}
+
+    // moving a vector keeps its data in place, so view_ stays valid
+    Input_data(Input_data &&) = default;
+    Input_data & operator=(Input_data &&) = default;
+    Input_data(const Input_data &) = delete;
+    Input_data & operator=(const Input_data &) = delete;
+
+    const unsigned char * data() const { return std::data(view_); }
+    std::size_t size() const { return std::size(view_); }
+    bool empty() const { return std::empty(view_); }
+    auto begin() const { return std::begin(view_); }
+    auto end() const { return std::end(view_); }
+    const unsigned char & operator[](std::size_t i) const { return view_[i]; }
+    operator std::span<const unsigned char>() const { return view_; }
+
+private:
+    std::vector<unsigned char> buffer_;
+    std::span<const unsigned char> view_;
+};
+
+#endif // INPUT_SOURCE_HPP
@@ -13,6 +13,21 @@
 
 #include "jp2_color.hpp"
 
+struct JP2_reader
+{
+    explicit JP2_reader(std::istream & input):
+        input{input}
+    {
+        input.seekg(0, std::ios_base::end);
+        size = input.tellg() - start;
+        input.seekg(start);
+    }
+
+    std::istream & input;
+    std::istream::pos_type start {input.tellg()};
+    std::size_t size {0};
+};
+
 struct JP2_io
 {
     std::size_t pos {0};
@@ -21,21 +36,38 @@ struct JP2_io
 
 OPJ_SIZE_T read_fun(void * buffer, OPJ_SIZE_T num_bytes, void * user)
 {
-    auto input = reinterpret_cast<JP2_io*>(user);
-    if(!input)
+    auto reader = reinterpret_cast<JP2_reader*>(user);
+    if(!reader)
         return -1;
 
-    if(input->pos == std::size(input->data))
+    reader->input.read(static_cast<char *>(buffer), num_bytes);
+    auto count = reader->input.gcount();
+
+    // hitting EOF sets failbit, which would keep seeking from working
+    reader->input.clear();
+
+    if(count == 0)
         return -1;
 
-    auto remaining = std::size(input->data) - input->pos;
-    if(num_bytes > remaining)
-        num_bytes = remaining;
+    return count;
+}
 
-    std::memcpy(buffer, std::data(input->data) + input->pos, num_bytes);
-    input->pos += num_bytes;
+OPJ_OFF_T read_skip_fun(OPJ_OFF_T off, void * user)
+{
+    auto reader = reinterpret_cast<JP2_reader*>(user);
+    if(!reader || !reader->input.seekg(off, std::ios_base::cur))
+        return -1;
 
-    return num_bytes;
+    return off;
+}
+
+OPJ_BOOL read_seek_fun(OPJ_OFF_T pos, void * user)
+{
+    auto reader = reinterpret_cast<JP2_reader*>(user);
+    if(!reader || !reader->input.seekg(reader->start + pos))
+        return OPJ_FALSE;
+
+    return OPJ_TRUE;
 }
 
 OPJ_SIZE_T write_fun(void * buffer, OPJ_SIZE_T num_bytes, void * user)
@@ -93,7 +125,10 @@ void warn_cb(const char * msg, void*)
 
 void Jp2::open(std::istream & input, const Args &)
 {
-    JP2_io reader {0, Image::read_input_to_memory(input)};
+    // input is seekable, even from a pipe, so it can be read as openjpeg needs it rather than read into memory first
+    JP2_reader reader {input};
+    if(!input)
+        throw std::runtime_error{"Could not read JP2 data"};
 
     auto codec_type {OPJ_CODEC_JP2};
     switch(type_)
@@ -129,8 +164,10 @@ void Jp2::open(std::istream & input, const Args &)
     }
 
     opj_stream_set_user_data(stream, &reader, nullptr);
-    opj_stream_set_user_data_length(stream, std::size(reader.data));
+    opj_stream_set_user_data_length(stream, reader.size);
     opj_stream_set_read_function(stream, read_fun);
+    opj_stream_set_skip_function(stream, read_skip_fun);
+    opj_stream_set_seek_function(stream, read_seek_fun);
 
     opj_set_error_handler(decoder, error_cb, nullptr);
     opj_set_warning_handler(decoder, warn_cb, nullptr);
@@ -285,7 +322,7 @@ void Jp2::open(std::istream & input, const Args &)
         orientation = exif::get_orientation(std::data(exif_buf), std::size(exif_buf)).value_or(orientation);
     }
 
-    transpose_image(orientation);
+    set_orientation(orientation);
     #endif
 }
 
@@ -10,6 +10,7 @@
 #include <jpeglib.h>
 
 #include "binio.hpp"
+#include "input_source.hpp"
 
 #ifdef EXIF_FOUND
 #include "exif.hpp"
@@ -29,7 +30,7 @@ struct Libjpeg
 {
     my_jpeg_error jerr;
 
-    inline static std::string error_msg = {"Generic error"};
+    inline static thread_local std::string error_msg = {"Generic error"};
 
     Libjpeg()
     {
@@ -99,7 +100,8 @@ class my_jpeg_source: public jpeg_source_mgr
 {
 public:
     explicit my_jpeg_source(std::istream & input):
-        input_{input}
+        input_{input},
+        source_{dynamic_cast<Input_source *>(input.rdbuf())}
     {
         init_source = [](j_decompress_ptr){};
         fill_input_buffer = my_fill_input_buffer;
@@ -115,16 +117,34 @@ private:
     {
         auto &src = *static_cast<my_jpeg_source*>(cinfo->src);
 
-        src.input_.read(reinterpret_cast<char *>(std::data(src.buffer_)), std::size(src.buffer_));
+        if(src.source_)
+        {
+            // an Input_source already has the data in memory. Let libjpeg read it in place
+            try
+            {
+                auto block = src.source_->read_block();
+                src.next_input_byte = std::data(block);
+                src.bytes_in_buffer = std::size(block);
+            }
+            catch(...)
+            {
+                src.bytes_in_buffer = 0;
+            }
+        }
+        else
+        {
+            src.input_.read(reinterpret_cast<char *>(std::data(src.buffer_)), std::size(src.buffer_));
 
-        src.next_input_byte = std::data(src.buffer_);
-        src.bytes_in_buffer = src.input_.gcount();
+            src.next_input_byte = std::data(src.buffer_);
+            src.bytes_in_buffer = src.input_.bad() ? 0 : src.input_.gcount();
+        }
 
-        if(src.input_.bad() || src.bytes_in_buffer == 0)
+        if(src.bytes_in_buffer == 0)
         {
             std::cerr<<"ERROR: Could not read JPEG image\n";
             src.buffer_[0] = 0xFF;
             src.buffer_[1] = JPEG_EOI;
+            src.next_input_byte = std::data(src.buffer_);
             src.bytes_in_buffer = 2;
             return false;
         }
@@ -150,6 +170,7 @@ private:
     }
 
     std::istream & input_;
+    Input_source * source_;
     std::array<JOCTET, 4096> buffer_;
 };
 
@@ -365,6 +386,14 @@ void Jpeg::open(std::istream & input, const Args & args)
 
         cinfo.set_error_point("Error reading JPEG");
 
+        // decode at reduced resolution if the full image is over the memory limit
+        jpeg_calc_output_dimensions(cinfo);
+        while(cinfo->scale_denom < 8 && !fits_memory_limit(cinfo->output_width, cinfo->output_height))
+        {
+            cinfo->scale_denom *= 2;
+            jpeg_calc_output_dimensions(cinfo);
+        }
+
         jpeg_start_decompress(cinfo);
 
         set_size(cinfo->output_width, cinfo->output_height);
@@ -378,12 +407,11 @@ void Jpeg::open(std::istream & input, const Args & args)
         {
             auto ptr = std::data(buffer);
             jpeg_read_scanlines(cinfo, &ptr, 1);
-            for(std::size_t i = 0; i < cinfo->output_width; ++i)
-                image_data_[cinfo->output_scanline - 1][i] = Color{buffer[i * 3], buffer[i * 3 + 1], buffer[i * 3 + 2]};
+            import_rows(std::data(buffer), 0, Pixel_format::RGB, cinfo->output_scanline - 1, 1);
         }
 
-        // rotate as needed
-        transpose_image(orientation);
+        // rotation is applied when displayed or converted
+        set_orientation(orientation);
         jpeg_finish_decompress(cinfo);
 
         if(parent_mpf && mpf && parent_mpf->num_images > 0)
@@ -103,14 +103,7 @@ void Jxl::open(std::istream & input, const Args &)
 
     set_size(info.xsize, info.ysize);
 
-    for(std::size_t row = 0; row < height_; ++row)
-    {
-        for(std::size_t col = 0; col < width_; ++col)
-        {
-            auto pixel = std::data(buffer) + (row * width_ + col) * 4;
-            image_data_[row][col] = Color{ pixel[0], pixel[1], pixel[2], pixel[3] };
-        }
-    }
+    import_rows(std::data(buffer), width_ * 4, Pixel_format::RGBA);
 }
 
 void Jxl::write(std::ostream & out, const Image & img, bool invert)
@@ -150,19 +143,7 @@ void Jxl::write(std::ostream & out, const Image & img, bool invert)
 
     std::vector<std::uint8_t> data(img.get_width() * img.get_height() * 4);
 
-    for(std::size_t row = 0; row < img.get_height(); ++row)
-    {
-        for(std::size_t col = 0; col < img.get_width(); ++col)
-        {
-            for(std::size_t i = 0; i < 4; ++i)
-            {
-                if(invert && i < 3)
-                    data[(row * img.get_width() + col) * 4 + i] = 255 - img[row][col][i];
-                else
-                    data[(row * img.get_width() + col) * 4 + i] = img[row][col][i];
-            }
-        }
-    }
+    img.export_rows(std::data(data), img.get_width() * 4, Pixel_format::RGBA, invert);
 
     if(JxlEncoderAddImageFrame(encoder_opts, &format, std::data(data), std::size(data) * sizeof(decltype(data)::value_type)) != JXL_ENC_SUCCESS)
         throw std::runtime_error {"Could not add JPEG XL image data"};
@@ -0,0 +1,76 @@
+#ifndef LRU_LIST_HPP
+#define LRU_LIST_HPP
+
+#include <iterator>
+#include <list>
+#include <unordered_map>
+
+// Keys in order of use, with adding, moving to the front, and removing all
+// O(1). Copies are independent of the original
+template <typename Key>
+class Lru_list
+{
+public:
+    Lru_list() = default;
+    Lru_list(const Lru_list & other): order_{other.order_} { index(); }
+    Lru_list & operator=(const Lru_list & other)
+    {
+        if(this != &other)
+        {
+            order_ = other.order_;
+            index();
+        }
+        return *this;
+    }
+    // moving a std::list keeps iterators to its elements valid
+    Lru_list(Lru_list &&) = default;
+    Lru_list & operator=(Lru_list &&) = default;
+
+    bool empty() const { return std::empty(order_); }
+    bool contains(const Key & key) const { return positions_.contains(key); }
+
+    // add key as the most recently used, or move it there
+    void touch(const Key & key)
+    {
+        if(auto pos = positions_.find(key); pos != std::end(positions_))
+            order_.splice(std::begin(order_), order_, pos->second);
+        else
+            positions_.emplace(key, order_.insert(std::begin(order_), key));
+    }
+
+    void erase(const Key & key)
+    {
+        if(auto pos = positions_.find(key); pos != std::end(positions_))
+        {
+            order_.erase(pos->second);
+            positions_.erase(pos);
+        }
+    }
+
+    void clear()
+    {
+        order_.clear();
+        positions_.clear();
+    }
+
+    // least recently used
+    const Key & back() const { return order_.back(); }
+    void pop_back()
+    {
+        positions_.erase(order_.back());
+        order_.pop_back();
+    }
+
+private:
+    void index()
+    {
+        positions_.clear();
+        for(auto i = std::begin(order_); i != std::end(order_); ++i)
+            positions_.emplace(*i, i);
+    }
+
+    std::list<Key> order_; // most recently used first
+    std::unordered_map<Key, typename std::list<Key>::iterator> positions_;
+};
+
+#endif // LRU_LIST_HPP
@@ -555,19 +555,20 @@ void MCMap::open(std::istream & input, const Args &)
 
     auto map_img = nbt_read_map(decompressed_input);
 
-    set_size(map_img.width, map_img.height);
+    set_size(map_img.width, map_img.height, {std::begin(mc_palette), std::end(mc_palette)});
 
     for(std::size_t row = 0; row < height_; ++row)
     {
+        auto indexes = index_row(row);
         for(std::size_t col = 0; col < width_; ++col)
         {
             if(auto index = map_img.colors[row * width_ + col]; index < std::size(mc_palette))
             {
-                image_data_[row][col] = mc_palette[index];
+                indexes[col] = index;
             }
             else
             {
-                image_data_[row][col] = mc_palette[0];
+                indexes[col] = 0;
                 std::cerr<<"Warning: MCMap index "<<static_cast<int>(index)<<" is out of range (0 - "<<std::size(mc_palette)<<")\n";
             }
         }
@@ -68,7 +68,7 @@ public:
     operator mng_data_struct const *() const { return mng_; }
 };
 
-void Mng::open(std::istream & input, const Args &)
+void Mng::open(std::istream & input, const Args & args)
 {
     struct Mng_info
     {
@@ -147,6 +147,7 @@ void Mng::open(std::istream & input, const Args &)
         auto mng_info = reinterpret_cast<Mng_info *>(mng_get_userdata(handle));
 
         mng_info->mng.images_.emplace_back(mng_info->mng.images_.back());
+        mng_info->mng.use_stored_image(std::size(mng_info->mng.images_) - 2);
 
         return MNG_TRUE;
     }) != MNG_NOERROR)
@@ -185,4 +186,6 @@ void Mng::open(std::istream & input, const Args &)
     mng.reset();
     move_image_data(images_.front());
     images_.erase(std::begin(images_));
+
+    deduplicate_frames(args.animate);
 }
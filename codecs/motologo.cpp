@@ -1,8 +1,10 @@
 #include "motologo.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 #include <cstdint>
@@ -50,17 +52,13 @@ constexpr auto image_magic_size = 8u;
 
 void MotoLogo::open(std::istream & input, const Args &)
 {
-    input.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+    auto data = read_input_to_memory(input);
+    Byte_reader in{data};
     try
     {
-        std::size_t pos {0};
-
         // header
-        input.ignore(magic_size); // Magic
-        std::uint32_t directory_size;
-        readb(input, directory_size, std::endian::little);
-
-        pos += magic_size + sizeof(directory_size);
+        in.skip(magic_size); // Magic
+        auto directory_size = in.read<std::uint32_t>(std::endian::little);
 
         const auto num_images = (directory_size - magic_size - sizeof(directory_size)) / dir_entry_size;
         auto name_lookup = std::unordered_map<std::string, unsigned int>{};
@@ -68,12 +66,9 @@ void MotoLogo::open(std::istream & input, const Args &)
 
         for(auto i = 0u; i < num_images; ++i)
         {
-            std::uint32_t offset, size;
-            auto name = readstr(input, name_size);
-            readb(input, offset, std::endian::little);
-            readb(input, size, std::endian::little);
-
-            pos += dir_entry_size;
+            auto name = in.read_string(name_size);
+            auto offset = in.read<std::uint32_t>(std::endian::little);
+            auto size = in.read<std::uint32_t>(std::endian::little);
 
             name.resize(name.find_first_of('\0'));
             name_lookup[name] = i;
@@ -89,23 +84,18 @@ void MotoLogo::open(std::istream & input, const Args &)
         for(auto i = 0u; i < num_images; ++i)
         {
             auto [offset, size] = locations[i];
-            input.ignore(offset - pos);
-            pos = offset;
+            in.seek(offset);
+
+            // the RLE data can't run past the end of the image
+            auto image = Byte_reader{in.read_span(std::min<std::size_t>(size, in.remaining()))};
 
             // read image
-            constexpr auto expected_image_magic = std::array{'M', 'o', 't', 'o', 'R', 'u', 'n', '\0'};
-            auto image_magic = std::array<char, image_magic_size>{};
-            input.read(std::data(image_magic), std::size(image_magic)); pos += std::size(image_magic);
-            for(auto j = 0u; j < image_magic_size; ++j)
-            {
-                if(image_magic[j] != expected_image_magic[j])
-                    throw std::runtime_error{"Error reading MotoLogo: Bad magic number on Image"};
-            }
+            constexpr auto expected_image_magic = std::string_view{"MotoRun\0", image_magic_size};
+            if(image.read_string(image_magic_size) != expected_image_magic)
+                throw std::runtime_error{"Error reading MotoLogo: Bad magic number on Image"};
 
-            std::uint16_t width, height;
-            readb(input, width, std::endian::big);
-            readb(input, height, std::endian::big);
-            pos += sizeof(std::uint16_t) * 2;
+            auto width = image.read<std::uint16_t>(std::endian::big);
+            auto height = image.read<std::uint16_t>(std::endian::big);
 
             auto & img = images_.emplace_back(width, height);
 
@@ -128,37 +118,26 @@ void MotoLogo::open(std::istream & input, const Args &)
                 }
             };
 
-            auto img_pos = 0u;
-            auto check_pos = [&pos, &img_pos, size=size](unsigned int bytes = 1) { if(pos += bytes, img_pos += bytes > size) throw std::runtime_error{"MotoLogo image read past size"}; };
             while(row < img.get_height())
             {
-                std::uint16_t count;
-                readb(input, count, std::endian::big); check_pos(sizeof(std::uint16_t));
+                auto count = image.read<std::uint16_t>(std::endian::big);
                 if(count & 0x7000u)
                     throw std::runtime_error{"Error reading MotoLogo: bad RLE count"};
 
                 bool repeat = count & 0x8000u;
                 count &= 0x0FFFu;
 
-                std::uint8_t r{0}, g{0}, b{0};
                 if(repeat)
                 {
-                    readb(input, b); check_pos();
-                    readb(input, g); check_pos();
-                    readb(input, r); check_pos();
-
+                    auto bgr = image.read_span(3);
                     for(auto i = 0u; i < count; ++i)
-                        write_pix(r, g, b);
+                        write_pix(bgr[2], bgr[1], bgr[0]);
                 }
                 else
                 {
-                    for(auto i = 0u; i < count; ++i)
-                    {
-                        readb(input, b); check_pos();
-                        readb(input, g); check_pos();
-                        readb(input, r); check_pos();
-                        write_pix(r, g, b);
-                    }
+                    auto bgr = image.read_span(3u * count);
+                    for(auto i = 0u; i < 3u * count; i += 3u)
+                        write_pix(bgr[i + 2], bgr[i + 1], bgr[i]);
                 }
             }
         }
@@ -175,12 +154,9 @@ void MotoLogo::open(std::istream & input, const Args &)
             images_.erase(std::begin(images_));
         }
     }
-    catch(std::ios_base::failure & e)
+    catch(const Unexpected_end_of_input &)
     {
-        if(input.bad())
-            throw std::runtime_error{"Error reading MotoLogo: could not read file"};
-        else
-            throw std::runtime_error{"Error reading MotoLogo: unexpected end of file"};
+        throw std::runtime_error{"Error reading MotoLogo: unexpected end of file"};
     }
 }
 
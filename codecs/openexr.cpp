@@ -30,7 +30,8 @@ public:
 
         auto ret = pos_;
         pos_ += n;
-        return reinterpret_cast<char *>(ret);
+        // OpenEXR only reads through this, so it's safe to point into read-only (possibly memory mapped) data
+        return const_cast<char *>(reinterpret_cast<const char *>(ret));
     }
 
     virtual bool read(char c[], int n) override
@@ -57,8 +58,8 @@ public:
     }
 
 private:
-    std::vector<unsigned char> data_;
-    unsigned char * pos_;
+    Input_data data_;
+    const unsigned char * pos_;
 };
 
 class OpenExr_writer: public Imf::OStream
@@ -116,13 +117,7 @@ void OpenEXR::open(std::istream & input, const Args &)
             file.setFrameBuffer(std::data(rowbuf) - dimensions.min.x - (dimensions.min.y + row) * width_, 1, width_); // no idea why the API will have the base pointer begfore the start of data
             file.readPixels(row + dimensions.min.y);
 
-            for(std::size_t col = 0; col < width_; ++col)
-            {
-                image_data_[row][col].r = rowbuf[col].r * 255.0f;
-                image_data_[row][col].g = rowbuf[col].g * 255.0f;
-                image_data_[row][col].b = rowbuf[col].b * 255.0f;
-                image_data_[row][col].a = rowbuf[col].a * 255.0f;
-            }
+            import_rows(std::data(rowbuf), 0, Pixel_format::RGBA_half, row, 1);
         }
     }
     catch(Iex::BaseExc & e)
@@ -141,25 +136,10 @@ void OpenEXR::write(std::ostream & out, const Image & img, bool invert)
         std::vector<Imf::Rgba> rowbuf(img.get_width());
         for(std::size_t row = 0; row < img.get_height(); ++row)
         {
+            img.export_rows(std::data(rowbuf), 0, Pixel_format::RGBA_half, invert, row, 1);
+
             file.setFrameBuffer(std::data(rowbuf) - row * img.get_width(), 1, img.get_width());
             file.writePixels(1);
-
-            for(std::size_t col = 0; col < img.get_width(); ++col)
-            {
-                if(invert)
-                {
-                    rowbuf[col].r = img[row][col].r / 255.0f;
-                    rowbuf[col].g = img[row][col].g / 255.0f;
-                    rowbuf[col].b = img[row][col].b / 255.0f;
-                }
-                else
-                {
-                    rowbuf[col].r = 1.0f - img[row][col].r / 255.0f;
-                    rowbuf[col].g = 1.0f - img[row][col].g / 255.0f;
-                    rowbuf[col].b = 1.0f - img[row][col].b / 255.0f;
-                }
-                rowbuf[col].a = img[row][col].a / 255.0f;
-            }
         }
 
         writer.output(out);
@@ -33,63 +33,64 @@ void Pcx::open(std::istream & input, const Args &)
     std::size_t palette_size = std::size(std_ega_palette);
 
     // TODO: some variations in palettes, bpp, # planes not tested due to lack of available images for testing. No 2 bpp, or RGBi images were found
-    input.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+    auto data = read_input_to_memory(input);
+    Byte_reader in{data};
     try
     {
-        input.ignore(1); // skip magic
+        in.skip(1); // skip magic
 
         std::uint8_t version;
-        readb(input, version);
+        in.read(version);
 
         Encoding encoding_type;
-        readb(input, encoding_type);
+        in.read(encoding_type);
 
         std::uint8_t bpp;
-        readb(input, bpp); // bits per pixel plane
+        in.read(bpp); // bits per pixel plane
 
         if(bpp != 1 && bpp != 2 && bpp != 4 && bpp != 8)
             throw std::runtime_error{"Invalid bits per pixel plane (" + std::to_string(bpp) + ") for PCX. must be 1,2,4, or 8"};
 
         std::uint16_t min_x, max_x, min_y, max_y;
-        readb(input, min_x);
-        readb(input, min_y);
-        readb(input, max_x);
-        readb(input, max_y);
+        in.read(min_x);
+        in.read(min_y);
+        in.read(max_x);
+        in.read(max_y);
 
         set_size(max_x - min_x + 1, max_y - min_y + 1);
 
-        input.ignore(4); // skip DPI
+        in.skip(4); // skip DPI
 
         std::array<Color, 16> ega_palette;
         for(auto && c: ega_palette)
         {
-            readb(input, c.r);
-            readb(input, c.g);
-            readb(input, c.b);
+            in.read(c.r);
+            in.read(c.g);
+            in.read(c.b);
             c.a = 255;
         }
 
         if(version != 0 && version != 3)
             palette = std::data(ega_palette);
 
-        input.ignore(1); // reserved
+        in.skip(1); // reserved
 
         std::uint8_t num_color_planes;
-        readb(input, num_color_planes);
+        in.read(num_color_planes);
 
         if(num_color_planes != 1 && num_color_planes != 3 && num_color_planes != 4)
             throw std::runtime_error{"Invalid number of color planes (" + std::to_string(num_color_planes) + ") for PCX. must be 1, 3, or 4"};
 
         std::uint16_t bytes_per_line_per_plane;
-        readb(input, bytes_per_line_per_plane);
+        in.read(bytes_per_line_per_plane);
 
         enum class Palette  : uint16_t {color = 1, grayscale = 2} palette_type;
-        readb(input, palette_type);
+        in.read(palette_type);
 
         if(palette_type != Palette::color && palette_type != Palette::grayscale)
             throw std::runtime_error{"Unknown PCX palette type: " + std::to_string(static_cast<std::underlying_type_t<Palette>>(palette_type))};
 
-        input.ignore(58); // screen size, and reserved
+        in.skip(58); // screen size, and reserved
 
         enum class Color_type {RGB_24, RGBA_32, RGB_12, RGBA_16, RGB_6, RGBA_8, indexed_256, indexed_16, indexed_4, grayscale_256, grayscale_16, grayscale_4, mono, RGBi} color_type{};
 
@@ -154,8 +155,7 @@ void Pcx::open(std::istream & input, const Args &)
         {
             for(std::size_t i = 0; i < std::size(decompressed); ++i)
             {
-                std::uint8_t b;
-                readb(input, b);
+                auto b = in.get();
 
                 if(encoding_type == Encoding::none)
                 {
@@ -166,8 +166,8 @@ void Pcx::open(std::istream & input, const Args &)
                     // RLE decoding
                     if((b & 0xC0) == 0xC0)
                     {
-                        std::uint8_t count = b & 0x3F, value;
-                        readb(input, value);
+                        std::uint8_t count = b & 0x3F;
+                        auto value = in.get();
 
                         if(i + count > std::size(decompressed))
                             throw std::runtime_error{"PCX RLE run length out of bounds"};
@@ -244,15 +244,7 @@ void Pcx::open(std::istream & input, const Args &)
             }
         }
         // check for VGA palette
-        std::uint8_t vga_indicator {0};
-
-        // suppress eof error
-        try { readb(input, vga_indicator); }
-        catch(std::ios_base::failure&)
-        {
-            if(input.bad())
-                throw;
-        }
+        std::uint8_t vga_indicator = in.at_end() ? 0 : in.get();
 
         std::array<Color, 256> vga_palette{};
         if(vga_indicator == 0xC)
@@ -260,18 +252,12 @@ void Pcx::open(std::istream & input, const Args &)
             palette_size = 0;
             for(auto && c: vga_palette)
             {
-                // suppress eof error
-                try { readb(input, c.r); }
-                catch(std::ios_base::failure&)
-                {
-                    if(input.bad())
-                        throw;
-                    else
-                        break;
-                }
+                if(in.at_end())
+                    break;
 
-                readb(input, c.g);
-                readb(input, c.b);
+                in.read(c.r);
+                in.read(c.g);
+                in.read(c.b);
                 c.a = 255;
 
                 ++palette_size;
@@ -280,6 +266,9 @@ void Pcx::open(std::istream & input, const Args &)
             palette = std::data(vga_palette);
         }
 
+        if(color_type == Color_type::indexed_256 || color_type == Color_type::indexed_16 || color_type == Color_type::indexed_4)
+            set_source_palette({palette, palette + palette_size});
+
         //  de-index if needed and store to image data
         for(std::size_t row = 0; row < height_; ++row)
         {
@@ -346,12 +335,9 @@ void Pcx::open(std::istream & input, const Args &)
             }
         }
     }
-    catch(std::ios_base::failure&)
+    catch(const Unexpected_end_of_input &)
     {
-        if(input.bad())
-            throw std::runtime_error{"Error reading PCX: could not read file"};
-        else
-            throw std::runtime_error{"Error reading PCX: unexpected end of file"};
+        throw std::runtime_error{"Error reading PCX: unexpected end of file"};
     }
 }
 
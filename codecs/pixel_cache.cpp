@@ -0,0 +1,346 @@
+#include "pixel_cache.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+
+#include "binio.hpp"
+
+/* File format notes (all values little-endian)
+*
+* Header:
+*     magic: 8 bytes: '\x89ASCPYR\n'
+*     version: uint32_t
+*     key_size: uint32_t
+*     key: key_size bytes, identifying what was decoded
+*     orientation: uint16_t, EXIF orientation to display with
+*     num_frames: uint32_t
+*     num_levels: uint32_t
+*     level sizes: num_levels x (width: uint32_t, height: uint32_t). Level 0 is full size, each after is half the last, rounded up.
+*         Animations have only level 0
+*     frames: num_frames x
+*         delay: float (bits as uint32_t), in seconds
+*         palette_size: uint32_t
+*         palette: palette_size x RGBA, colors the frame was made from
+*         index_palette_size: uint32_t, 0 if level 0 is RGBA
+*         index_palette: index_palette_size x RGBA, colors of the indexes in level 0
+*         level offsets: num_levels x uint64_t, from file start. Frames with the same pixels share offsets
+*
+* pixel data:
+*     each level of each frame: RGBA rows (or 1 byte index rows for an indexed level 0), not rotated for orientation
+*/
+
+namespace
+{
+    constexpr auto magic = std::string_view{"\x89" "ASCPYR\n"};
+    constexpr std::uint32_t version = 2u;
+
+    // levels stop once they're this small
+    constexpr std::uint32_t min_level_size = 32u;
+
+    using Level_sizes = std::vector<std::pair<std::uint32_t, std::uint32_t>>;
+
+    bool is_transposed(exif::Orientation orientation)
+    {
+        return orientation == exif::Orientation::r_90 || orientation == exif::Orientation::r_270;
+    }
+
+    // the smallest level at least as big as what args will display (as display.cpp works that out), that fits in the memory limit
+    std::size_t choose_level(const Level_sizes & sizes, exif::Orientation orientation, const Args & args)
+    {
+        auto display_size = [transposed = is_transposed(orientation)](const auto & size)
+        {
+            return transposed ? std::pair{size.second, size.first} : size;
+        };
+
+        auto [full_width, full_height] = display_size(sizes.front());
+        auto cols = static_cast<std::size_t>(args.cols ? *args.cols : std::min({80, get_screen_cols(), static_cast<int>(full_width)}));
+        auto rows = args.rows && *args.rows > 0
+            ? static_cast<std::size_t>(*args.rows) * (args.disp_char == Args::Disp_char::HALF_BLOCK ? 2u : 1u)
+            : (cols * full_height + full_width - 1u) / full_width;
+
+        std::size_t level = 0;
+        while(level + 1 < std::size(sizes))
+        {
+            auto [width, height] = display_size(sizes[level + 1]);
+            if(Image::fits_memory_limit(sizes[level].first, sizes[level].second) && (width < cols || height < rows))
+                break;
+            ++level;
+        }
+        return level;
+    }
+
+    // what's written for an image: the frames args would display, and where the levels of each go
+    struct Layout
+    {
+        std::vector<const Image *> frames;
+        std::vector<float> delays;
+        Level_sizes sizes;
+        std::vector<std::size_t> data_frame;              // for each frame, the first frame with the same stored data
+        std::vector<std::vector<std::uint64_t>> offsets; // for each frame, of each level
+        std::uint64_t file_size {0};
+    };
+
+    Layout plan_layout(const Image & img, const Args & args, const std::string & key)
+    {
+        Layout layout;
+        if(args.animate)
+        {
+            for(std::size_t i = 0; i < img.num_frames(); ++i)
+            {
+                layout.frames.push_back(&img.get_frame(i));
+                layout.delays.push_back(img.get_frame_delay(i).count());
+            }
+        }
+        else
+        {
+            layout.frames.push_back(args.frame_no ? &img.get_frame(*args.frame_no) : &img.get_image(args.image_no.value_or(0u)));
+            layout.delays.push_back(0.0f);
+        }
+
+        // animations are shown at one size throughout, so don't need the smaller levels
+        auto & sizes = layout.sizes;
+        sizes.emplace_back(layout.frames.front()->get_width(), layout.frames.front()->get_height());
+        while(std::size(layout.frames) == 1u && std::max(sizes.back().first, sizes.back().second) > min_level_size)
+            sizes.emplace_back((sizes.back().first + 1u) / 2u, (sizes.back().second + 1u) / 2u);
+
+        layout.file_size = std::size(magic) + sizeof(std::uint32_t) * 2u + std::size(key) + sizeof(std::uint16_t)
+            + sizeof(std::uint32_t) * 2u + std::size(sizes) * sizeof(std::uint32_t) * 2u;
+        for(auto && frame: layout.frames)
+        {
+            layout.file_size += sizeof(std::uint32_t) * 3u + std::size(frame->get_source_palette()) * bytes_per_pixel(Pixel_format::RGBA)
+                + std::size(sizes) * sizeof(std::uint64_t);
+            if(frame->is_indexed())
+                layout.file_size += std::size(frame->get_palette()) * bytes_per_pixel(Pixel_format::RGBA);
+        }
+
+        // frames sharing stored data (as deduplicate_frames leaves them) are written once
+        std::unordered_map<const Image *, std::size_t> first_frames;
+        for(std::size_t i = 0; i < std::size(layout.frames); ++i)
+        {
+            auto & frame = layout.frames[i];
+            auto first = first_frames.try_emplace(frame, i).first->second;
+            layout.data_frame.push_back(first);
+            if(first != i)
+            {
+                layout.offsets.push_back(layout.offsets[first]);
+                continue;
+            }
+
+            auto & offsets = layout.offsets.emplace_back();
+            for(auto && [level_width, level_height]: sizes)
+            {
+                offsets.push_back(layout.file_size);
+                auto pixel_size = std::size(offsets) == 1u && frame->is_indexed() ? 1u : bytes_per_pixel(Pixel_format::RGBA);
+                layout.file_size += std::uint64_t{level_width} * level_height * pixel_size;
+            }
+        }
+
+        return layout;
+    }
+
+    void write_palette(std::ostream & out, const std::vector<Color> & palette)
+    {
+        writeb(out, static_cast<std::uint32_t>(std::size(palette)));
+        for(auto && c: palette)
+        {
+            for(auto channel: {c.r, c.g, c.b, c.a})
+                writeb(out, channel);
+        }
+    }
+
+    std::vector<Color> read_palette(Byte_reader & in)
+    {
+        std::vector<Color> palette(in.read<std::uint32_t>());
+        auto palette_data = in.read_span(std::size(palette) * bytes_per_pixel(Pixel_format::RGBA));
+        for(std::size_t c = 0; c < std::size(palette); ++c)
+            palette[c] = Color{palette_data[c * 4], palette_data[c * 4 + 1], palette_data[c * 4 + 2], palette_data[c * 4 + 3]};
+        return palette;
+    }
+
+    void write_level(std::ostream & out, const Image & level)
+    {
+        if(level.is_indexed())
+        {
+            for(std::size_t y = 0; y < level.get_height(); ++y)
+            {
+                auto row = level.index_row(y);
+                out.write(reinterpret_cast<const char *>(std::data(row)), static_cast<std::streamsize>(std::size(row)));
+            }
+            return;
+        }
+
+        std::vector<unsigned char> row(level.get_width() * bytes_per_pixel(Pixel_format::RGBA));
+        for(std::size_t y = 0; y < level.get_height(); ++y)
+        {
+            level.export_rows(std::data(row), std::size(row), Pixel_format::RGBA, false, y, 1);
+            out.write(reinterpret_cast<const char *>(std::data(row)), static_cast<std::streamsize>(std::size(row)));
+        }
+    }
+}
+
+void Pixel_cache::open(std::istream & input, const Args & args)
+{
+    auto data = read_input_to_memory(input);
+    Byte_reader in{data};
+    try
+    {
+        in.skip(std::size(magic));
+        if(in.read<std::uint32_t>() != version)
+            throw std::runtime_error{"Error reading pixel cache: unsupported version"};
+
+        in.skip(in.read<std::uint32_t>()); // key
+
+        auto orientation = in.read<exif::Orientation>();
+        if(orientation != exif::Orientation::r_0 && orientation != exif::Orientation::r_90
+                && orientation != exif::Orientation::r_180 && orientation != exif::Orientation::r_270)
+            throw std::runtime_error{"Error reading pixel cache: invalid orientation"};
+
+        auto num_frames = in.read<std::uint32_t>();
+        auto num_levels = in.read<std::uint32_t>();
+        if(num_frames == 0 || num_levels == 0)
+            throw std::runtime_error{"Error reading pixel cache: no images"};
+
+        Level_sizes sizes(num_levels);
+        for(auto && [width, height]: sizes)
+        {
+            in.read(width);
+            in.read(height);
+            if(width == 0 || height == 0 || height > std::numeric_limits<std::size_t>::max() / bytes_per_pixel(Pixel_format::RGBA) / width)
+                throw std::runtime_error{"Error reading pixel cache: invalid image size"};
+        }
+
+        auto level = choose_level(sizes, orientation, args);
+        auto [width, height] = sizes[level];
+        auto stride = width * bytes_per_pixel(Pixel_format::RGBA);
+
+        images_.reserve(num_frames);
+        frame_delays_.reserve(num_frames);
+        for(auto i = 0u; i < num_frames; ++i)
+        {
+            frame_delays_.emplace_back(std::bit_cast<float>(in.read<std::uint32_t>()));
+
+            auto palette = read_palette(in);
+            auto index_palette = read_palette(in);
+            if(std::size(index_palette) > 256u)
+                throw std::runtime_error{"Error reading pixel cache: invalid palette"};
+
+            in.skip(level * sizeof(std::uint64_t));
+            auto offset = in.read<std::uint64_t>();
+            in.skip((num_levels - level - 1u) * sizeof(std::uint64_t));
+
+            // only the chosen level is read, so the rest of a mapped file is never paged in
+            auto pixels = Byte_reader{data};
+            pixels.seek(offset);
+
+            auto & frame = images_.emplace_back();
+            if(level == 0 && !std::empty(index_palette))
+            {
+                frame.set_size(width, height, index_palette);
+                for(std::size_t y = 0; y < height; ++y)
+                    std::ranges::copy(pixels.read_span(width), std::begin(frame.index_row(y)));
+            }
+            else
+            {
+                frame.set_size(width, height);
+                frame.import_rows(std::data(pixels.read_span(stride * height)), stride, Pixel_format::RGBA);
+            }
+            frame.set_source_palette(std::move(palette));
+            frame.set_orientation(orientation);
+        }
+
+        move_image_data(images_.front());
+        images_.erase(std::begin(images_));
+
+        deduplicate_frames(args.animate);
+    }
+    catch(const Unexpected_end_of_input &)
+    {
+        throw std::runtime_error{"Error reading pixel cache: unexpected end of file"};
+    }
+}
+
+void Pixel_cache::write(std::ostream & out, const Image & img, const Args & args, const std::string & key)
+{
+    auto layout = plan_layout(img, args, key);
+    auto & frames = layout.frames;
+    auto & sizes = layout.sizes;
+
+    auto width = frames.front()->get_width();
+    auto height = frames.front()->get_height();
+    if(width == 0 || height == 0 || width > std::numeric_limits<std::uint32_t>::max() || height > std::numeric_limits<std::uint32_t>::max())
+        throw std::runtime_error{"Error writing pixel cache: invalid image size"};
+    if(std::any_of(std::begin(frames), std::end(frames), [width, height](const Image * frame) { return frame->get_width() != width || frame->get_height() != height; }))
+        throw std::runtime_error{"Error writing pixel cache: frames differ in size"};
+
+    writestr(out, magic);
+    writeb(out, version);
+    writeb(out, static_cast<std::uint32_t>(std::size(key)));
+    writestr(out, key);
+    writeb(out, frames.front()->get_orientation());
+    writeb(out, static_cast<std::uint32_t>(std::size(frames)));
+    writeb(out, static_cast<std::uint32_t>(std::size(sizes)));
+    for(auto && [level_width, level_height]: sizes)
+    {
+        writeb(out, level_width);
+        writeb(out, level_height);
+    }
+
+    for(std::size_t i = 0; i < std::size(frames); ++i)
+    {
+        writeb(out, std::bit_cast<std::uint32_t>(layout.delays[i]));
+        write_palette(out, frames[i]->get_source_palette());
+        write_palette(out, frames[i]->is_indexed() ? frames[i]->get_palette() : std::vector<Color>{});
+        for(auto offset: layout.offsets[i])
+            writeb(out, offset);
+    }
+
+    for(std::size_t i = 0; i < std::size(frames); ++i)
+    {
+        if(layout.data_frame[i] != i)
+            continue;
+
+        // levels are kept as stored, and rotated when displayed
+        Image level;
+        level.copy_image_data(*frames[i]);
+        level.set_orientation(exif::Orientation::r_0);
+        level.make_resident(true);
+        write_level(out, level);
+
+        for(std::size_t l = 1; l < std::size(sizes); ++l)
+        {
+            level = level.scale(sizes[l].first, sizes[l].second);
+            write_level(out, level);
+        }
+    }
+
+    if(!out)
+        throw std::runtime_error{"Error writing pixel cache"};
+}
+
+std::uint64_t Pixel_cache::file_size(const Image & img, const Args & args, const std::string & key)
+{
+    return plan_layout(img, args, key).file_size;
+}
+
+std::string Pixel_cache::read_key(std::span<const unsigned char> data)
+{
+    try
+    {
+        Byte_reader in{data};
+        if(in.read_string(std::size(magic)) != magic || in.read<std::uint32_t>() != version)
+            return {};
+        return in.read_string(in.read<std::uint32_t>());
+    }
+    catch(const Unexpected_end_of_input &)
+    {
+        return {};
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef PIXEL_CACHE_HPP
+#define PIXEL_CACHE_HPP
+
+#include <span>
+#include <string>
+
+#include "image.hpp"
+
+inline bool is_pixel_cache(const Image::Header & header)
+{
+    const std::array<unsigned char, 8> pixel_cache_header = {0x89, 'A', 'S', 'C', 'P', 'Y', 'R', '\n'};
+
+    return std::equal(std::begin(pixel_cache_header), std::end(pixel_cache_header), std::begin(header), Image::header_cmp);
+}
+
+// asciiart's own store of decoded images, so slow formats only need decoding once. Each frame is kept at full size
+// (as indexes if it was decoded that way, otherwise RGBA), and still images also have a pyramid of RGBA levels each
+// half the size of the last. Opening reads only the smallest level that's
+// still at least as big as what args will display, so a large image costs about as much to open as a small one.
+// Files are read in place when mapped
+class Pixel_cache final: public Image
+{
+public:
+    Pixel_cache() = default;
+    void open(std::istream & input, const Args & args) override;
+
+    bool supports_animation() const override { return true; }
+
+    // store the frames of img that args would display: all of them when animating, otherwise the one image or frame
+    // selected. key identifies what was decoded, and is returned by read_key
+    static void write(std::ostream & out, const Image & img, const Args & args, const std::string & key);
+
+    // size of what write would write, without decoding or scaling anything
+    static std::uint64_t file_size(const Image & img, const Args & args, const std::string & key);
+
+    // key written with data, or empty if data isn't a pixel cache file
+    static std::string read_key(std::span<const unsigned char> data);
+};
+#endif // PIXEL_CACHE_HPP
@@ -0,0 +1,208 @@
+#include "pixel_format.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+#include <cstdint>
+#include <cstring>
+
+static_assert(sizeof(Color) == 4, "Color must be 4 packed bytes (RGBA)");
+
+namespace
+{
+    float half_to_float(std::uint16_t h)
+    {
+        const std::uint32_t sign = static_cast<std::uint32_t>(h & 0x8000u) << 16;
+        const std::uint32_t exp  = (h >> 10) & 0x1Fu;
+        const std::uint32_t mant = h & 0x3FFu;
+
+        if(exp == 0) // zero or subnormal
+            return (sign ? -1.0f : 1.0f) * static_cast<float>(mant) / 16777216.0f; // mant * 2^-24
+        else if(exp == 0x1F) // inf or NaN
+            return std::bit_cast<float>(sign | 0x7F800000u | (mant << 13));
+        else
+            return std::bit_cast<float>(sign | ((exp + 127u - 15u) << 23) | (mant << 13));
+    }
+
+    // only needs to handle finite values. Values too small for a normal half are flushed to 0
+    std::uint16_t float_to_half(float f)
+    {
+        const auto bits = std::bit_cast<std::uint32_t>(f);
+        const auto sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000u);
+        const auto exp  = static_cast<int>((bits >> 23) & 0xFFu) - 127 + 15;
+        const auto mant = bits & 0x7FFFFFu;
+
+        if(exp <= 0)
+            return sign;
+        if(exp >= 0x1F)
+            return sign | 0x7C00u;
+
+        // round to nearest. A carry out of the mantissa correctly bumps the exponent
+        auto h = static_cast<std::uint16_t>(sign | (exp << 10) | (mant >> 13));
+        if(mant & 0x1000u)
+            ++h;
+        return h;
+    }
+
+    unsigned char unit_to_byte(float f)
+    {
+        return static_cast<unsigned char>(std::clamp(f, 0.0f, 1.0f) * 255.0f);
+    }
+}
+
+std::size_t bytes_per_pixel(Pixel_format format)
+{
+    switch(format)
+    {
+    case Pixel_format::RGBA:
+    case Pixel_format::BGRA:
+    case Pixel_format::BGRA_premultiplied:
+    case Pixel_format::ABGR_32:
+        return 4;
+    case Pixel_format::RGB:
+        return 3;
+    case Pixel_format::GRAY:
+        return 1;
+    case Pixel_format::GRAY_ALPHA:
+        return 2;
+    case Pixel_format::RGBA_half:
+        return 8;
+    }
+    throw std::logic_error{"Unknown pixel format"};
+}
+
+void import_row(const unsigned char * src, Color * dest, std::size_t width, Pixel_format format)
+{
+    switch(format)
+    {
+    case Pixel_format::RGBA:
+        std::memcpy(dest, src, width * sizeof(Color));
+        break;
+
+    case Pixel_format::RGB:
+        for(std::size_t i = 0; i < width; ++i)
+            dest[i] = Color{src[3 * i], src[3 * i + 1], src[3 * i + 2]};
+        break;
+
+    case Pixel_format::BGRA:
+        for(std::size_t i = 0; i < width; ++i)
+            dest[i] = Color{src[4 * i + 2], src[4 * i + 1], src[4 * i], src[4 * i + 3]};
+        break;
+
+    case Pixel_format::BGRA_premultiplied:
+        for(std::size_t i = 0; i < width; ++i)
+        {
+            const unsigned int a = src[4 * i + 3];
+            auto unmultiply = [a](unsigned int c) { return static_cast<unsigned char>(a == 0 ? 0 : std::min(255u, (c * 255u + a / 2u) / a)); };
+            dest[i] = Color{unmultiply(src[4 * i + 2]), unmultiply(src[4 * i + 1]), unmultiply(src[4 * i]), static_cast<unsigned char>(a)};
+        }
+        break;
+
+    case Pixel_format::GRAY:
+        for(std::size_t i = 0; i < width; ++i)
+            dest[i] = Color{src[i]};
+        break;
+
+    case Pixel_format::GRAY_ALPHA:
+        for(std::size_t i = 0; i < width; ++i)
+            dest[i] = Color{src[2 * i], src[2 * i], src[2 * i], src[2 * i + 1]};
+        break;
+
+    case Pixel_format::ABGR_32:
+        for(std::size_t i = 0; i < width; ++i)
+        {
+            std::uint32_t pix;
+            std::memcpy(&pix, src + 4 * i, sizeof(pix));
+            dest[i] = Color{static_cast<unsigned char>(pix), static_cast<unsigned char>(pix >> 8), static_cast<unsigned char>(pix >> 16), static_cast<unsigned char>(pix >> 24)};
+        }
+        break;
+
+    case Pixel_format::RGBA_half:
+        for(std::size_t i = 0; i < width; ++i)
+        {
+            std::uint16_t half[4];
+            std::memcpy(half, src + 8 * i, sizeof(half));
+            dest[i] = Color{unit_to_byte(half_to_float(half[0])), unit_to_byte(half_to_float(half[1])), unit_to_byte(half_to_float(half[2])), unit_to_byte(half_to_float(half[3]))};
+        }
+        break;
+    }
+}
+
+void export_row(const Color * src, unsigned char * dest, std::size_t width, Pixel_format format, bool invert)
+{
+    // 255 - c == 255 ^ c, so inverting doesn't need a branch per pixel
+    const unsigned char inv = invert ? 0xFF : 0x00;
+
+    switch(format)
+    {
+    case Pixel_format::RGBA:
+        for(std::size_t i = 0; i < width; ++i)
+        {
+            dest[4 * i]     = src[i].r ^ inv;
+            dest[4 * i + 1] = src[i].g ^ inv;
+            dest[4 * i + 2] = src[i].b ^ inv;
+            dest[4 * i + 3] = src[i].a;
+        }
+        break;
+
+    case Pixel_format::RGB:
+        for(std::size_t i = 0; i < width; ++i)
+        {
+            dest[3 * i]     = src[i].r ^ inv;
+            dest[3 * i + 1] = src[i].g ^ inv;
+            dest[3 * i + 2] = src[i].b ^ inv;
+        }
+        break;
+
+    case Pixel_format::BGRA:
+        for(std::size_t i = 0; i < width; ++i)
+        {
+            dest[4 * i]     = src[i].b ^ inv;
+            dest[4 * i + 1] = src[i].g ^ inv;
+            dest[4 * i + 2] = src[i].r ^ inv;
+            dest[4 * i + 3] = src[i].a;
+        }
+        break;
+
+    case Pixel_format::BGRA_premultiplied:
+        for(std::size_t i = 0; i < width; ++i)
+        {
+            const unsigned int a = src[i].a;
+            auto multiply = [a](unsigned char c) { return static_cast<unsigned char>((c * a + 127u) / 255u); };
+            dest[4 * i]     = multiply(src[i].b ^ inv);
+            dest[4 * i + 1] = multiply(src[i].g ^ inv);
+            dest[4 * i + 2] = multiply(src[i].r ^ inv);
+            dest[4 * i + 3] = src[i].a;
+        }
+        break;
+
+    case Pixel_format::ABGR_32:
+        for(std::size_t i = 0; i < width; ++i)
+        {
+            const auto pix = static_cast<std::uint32_t>(src[i].r ^ inv)
+                | static_cast<std::uint32_t>(src[i].g ^ inv) << 8
+                | static_cast<std::uint32_t>(src[i].b ^ inv) << 16
+                | static_cast<std::uint32_t>(src[i].a) << 24;
+            std::memcpy(dest + 4 * i, &pix, sizeof(pix));
+        }
+        break;
+
+    case Pixel_format::RGBA_half:
+        for(std::size_t i = 0; i < width; ++i)
+        {
+            const std::uint16_t half[4] = {
+                float_to_half(static_cast<float>(src[i].r ^ inv) / 255.0f),
+                float_to_half(static_cast<float>(src[i].g ^ inv) / 255.0f),
+                float_to_half(static_cast<float>(src[i].b ^ inv) / 255.0f),
+                float_to_half(static_cast<float>(src[i].a) / 255.0f)
+            };
+            std::memcpy(dest + 8 * i, half, sizeof(half));
+        }
+        break;
+
+    case Pixel_format::GRAY:
+    case Pixel_format::GRAY_ALPHA:
+        throw std::logic_error{"Gray pixel formats can't be exported"};
+    }
+}
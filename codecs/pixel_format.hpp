@@ -0,0 +1,29 @@
+#ifndef PIXEL_FORMAT_HPP
+#define PIXEL_FORMAT_HPP
+
+#include <cstddef>
+
+#include "../color.hpp"
+
+// pixel data layouts used by codec libraries. 8 bits per channel unless noted
+enum class Pixel_format
+{
+    RGBA,
+    RGB,
+    BGRA,
+    BGRA_premultiplied, // cairo's ARGB32, on little-endian machines
+    GRAY,               // import only
+    GRAY_ALPHA,         // import only
+    ABGR_32,            // native-endian 32-bit ints, red in the low byte (libtiff RGBA images)
+    RGBA_half,          // 16-bit floats, 0.0 - 1.0 (OpenEXR's Rgba)
+};
+
+std::size_t bytes_per_pixel(Pixel_format format);
+
+// Convert a row of pixels. Each format has its own straight loop over the row,
+// so the compiler is free to vectorize it
+void import_row(const unsigned char * src, Color * dest, std::size_t width, Pixel_format format);
+// invert applies to color channels only, not alpha
+void export_row(const Color * src, unsigned char * dest, std::size_t width, Pixel_format format, bool invert = false);
+
+#endif // PIXEL_FORMAT_HPP
@@ -0,0 +1,215 @@
+#ifndef PIXEL_ROWS_HPP
+#define PIXEL_ROWS_HPP
+
+#include <iterator>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <cassert>
+#include <cstdint>
+
+#include "../color.hpp"
+#include "spill_file.hpp"
+
+// Image pixel data, stored by row. Copies share rows until they are written to
+// (copy-on-write), so animation frames composed from a previous frame only
+// store the rows that actually changed.
+// Any non-const access to a row gives that copy its own row, so read through
+// a const reference when not modifying, and take a reference to a row once
+// rather than indexing it again for each pixel
+//
+// Paletted and grayscale sources can instead be stored indexed, at 1 byte per
+// pixel. Code that knows about the indexed format (the scaler) reads it through
+// index_row() and palette(). Full color data can also be spilled to a
+// Spill_file. Either has to be expanded back to rows of Colors before those can
+// be read, by expand() or by any non-const access. Const access never expands,
+// so it's safe from several threads at once, but is only valid once expanded
+class Pixel_rows
+{
+public:
+    using Row = std::vector<Color>;
+
+    Pixel_rows() = default;
+    explicit Pixel_rows(std::size_t height) { resize(height); }
+
+    const Row & operator[](std::size_t i) const { assert(is_expanded()); return *rows_[i]; }
+    Row & operator[](std::size_t i) { expand(); return unshare(rows_[i]); }
+
+    std::size_t size() const { return indexed_ ? std::size(indexed_->rows) : spilled_ ? spilled_->height : std::size(rows_); }
+    bool empty() const { return size() == 0; }
+    void clear() { rows_.clear(); indexed_.reset(); spilled_.reset(); }
+    void resize(std::size_t height)
+    {
+        expand();
+        auto old_height = std::size(rows_);
+        rows_.resize(height);
+        for(auto i = old_height; i < height; ++i)
+            rows_[i] = std::make_shared<Row>();
+    }
+
+    // switch to indexed storage, with all pixels set to index 0. Palettes are padded to 256 entries
+    void set_indexed(std::size_t width, std::size_t height, std::vector<Color> palette)
+    {
+        palette.resize(256);
+        rows_.clear();
+        spilled_.reset();
+        indexed_ = std::make_shared<Indexed>(Indexed{std::move(palette), std::vector<std::vector<std::uint8_t>>(height, std::vector<std::uint8_t>(width))});
+    }
+    bool is_indexed() const { return static_cast<bool>(indexed_); }
+    std::span<const std::uint8_t> index_row(std::size_t i) const { return indexed_->rows[i]; }
+    std::span<std::uint8_t> index_row(std::size_t i)
+    {
+        if(indexed_.use_count() > 1)
+            indexed_ = std::make_shared<Indexed>(*indexed_);
+        return indexed_->rows[i];
+    }
+    const std::vector<Color> & palette() const { return indexed_->palette; }
+
+    // move full color data out to file. Indexed data is left alone, since it's already compact
+    void spill(const std::shared_ptr<Spill_file> & file) const
+    {
+        if(indexed_ || spilled_ || std::empty(rows_))
+            return;
+
+        auto width = std::size(*rows_.front());
+        auto spilled = std::make_shared<Spilled>(file, file->allocate(width * std::size(rows_)), width, std::size(rows_));
+        for(std::size_t i = 0; i < std::size(rows_); ++i)
+            file->write(spilled->offset + i * width, *rows_[i]);
+
+        rows_.clear();
+        spilled_ = std::move(spilled);
+    }
+    bool is_spilled() const { return static_cast<bool>(spilled_); }
+    // whether rows can be read as Colors
+    bool is_expanded() const { return !indexed_ && !spilled_; }
+
+    // bytes this copy holds in memory, with rows shared between copies split evenly between them. Summed over all
+    // copies, that's the memory they use together. Spilled data counts as 0
+    std::size_t memory_share() const
+    {
+        if(indexed_)
+            return std::empty(indexed_->rows) ? 0 : std::size(indexed_->rows) * std::size(indexed_->rows.front()) / indexed_.use_count();
+
+        std::size_t size = 0;
+        for(auto & row: rows_)
+            size += std::size(*row) * sizeof(Color) / row.use_count();
+        return size;
+    }
+
+    // read spilled data back in. Like expand(), this isn't thread safe, so do it before sharing the data between threads
+    void unspill() const
+    {
+        if(!spilled_)
+            return;
+
+        rows_.resize(spilled_->height);
+        for(std::size_t i = 0; i < std::size(rows_); ++i)
+        {
+            rows_[i] = std::make_shared<Row>(spilled_->width);
+            spilled_->file->read(spilled_->offset + i * spilled_->width, *rows_[i]);
+        }
+        spilled_.reset();
+    }
+
+    // convert indexed or spilled storage to full color
+    void expand() const
+    {
+        if(spilled_)
+        {
+            unspill();
+            return;
+        }
+
+        if(!indexed_)
+            return;
+
+        rows_.resize(std::size(indexed_->rows));
+        for(std::size_t i = 0; i < std::size(rows_); ++i)
+        {
+            auto & indexes = indexed_->rows[i];
+            rows_[i] = std::make_shared<Row>(std::size(indexes));
+            for(std::size_t col = 0; col < std::size(indexes); ++col)
+                (*rows_[i])[col] = indexed_->palette[indexes[col]];
+        }
+        indexed_.reset();
+    }
+
+    template <bool is_const>
+    class Iterator
+    {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = Row;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<is_const, const Row *, Row *>;
+        using reference = std::conditional_t<is_const, const Row &, Row &>;
+        using Ptr_iter = std::conditional_t<is_const, typename std::vector<std::shared_ptr<Row>>::const_iterator, typename std::vector<std::shared_ptr<Row>>::iterator>;
+
+        Iterator() = default;
+        explicit Iterator(Ptr_iter i): i_{i} {}
+
+        reference operator*() const
+        {
+            if constexpr(is_const)
+                return **i_;
+            else
+                return unshare(*i_);
+        }
+        pointer operator->() const { return &**this; }
+
+        Iterator & operator++() { ++i_; return *this; }
+        Iterator operator++(int) { auto tmp = *this; ++i_; return tmp; }
+        Iterator & operator--() { --i_; return *this; }
+        Iterator operator--(int) { auto tmp = *this; --i_; return tmp; }
+
+        bool operator==(const Iterator & other) const { return i_ == other.i_; }
+
+    private:
+        Ptr_iter i_;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    iterator begin() { expand(); return iterator{std::begin(rows_)}; }
+    iterator end() { expand(); return iterator{std::end(rows_)}; }
+    const_iterator begin() const { assert(is_expanded()); return const_iterator{std::cbegin(rows_)}; }
+    const_iterator end() const { assert(is_expanded()); return const_iterator{std::cend(rows_)}; }
+
+private:
+    static Row & unshare(std::shared_ptr<Row> & row)
+    {
+        if(row.use_count() > 1)
+            row = std::make_shared<Row>(*row);
+        return *row;
+    }
+
+    struct Indexed
+    {
+        std::vector<Color> palette;
+        std::vector<std::vector<std::uint8_t>> rows;
+    };
+
+    // releases its space in the file once no copies refer to it
+    struct Spilled
+    {
+        std::shared_ptr<Spill_file> file;
+        std::size_t offset, width, height;
+
+        Spilled(std::shared_ptr<Spill_file> file, std::size_t offset, std::size_t width, std::size_t height):
+            file{std::move(file)}, offset{offset}, width{width}, height{height}
+        {}
+        ~Spilled() { file->release(offset, width * height); }
+        Spilled(const Spilled &) = delete;
+        Spilled & operator=(const Spilled &) = delete;
+    };
+
+    mutable std::vector<std::shared_ptr<Row>> rows_;
+    mutable std::shared_ptr<Indexed> indexed_;
+    mutable std::shared_ptr<Spilled> spilled_;
+};
+
+#endif // PIXEL_ROWS_HPP
@@ -59,14 +59,7 @@ void decompress(Input_bitstream<InputIter> & bits, std::uint8_t tile_width, std:
     {
         if(state == State::RLE)
         {
-            std::uint8_t bit_count = 1u;
-            while(true)
-            {
-                auto b = bits(1);
-                if(!b)
-                    break;
-                ++bit_count;
-            }
+            auto bit_count = static_cast<std::uint8_t>(1u + bits.read_unary());
 
             auto value = bits.template read<std::uint16_t>(bit_count);
             value += (1 << bit_count) - 1;
@@ -252,10 +245,10 @@ void copy_and_arrange_buf(std::uint8_t * dst, std::uint8_t * src, std::uint8_t t
 
 void Pkmn_gen1::open(std::istream & input, const Args &)
 {
-    input.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+    auto data = read_input_to_memory(input);
     try
     {
-        auto bits = Input_bitstream{std::istreambuf_iterator<char>{input}};
+        auto bits = Input_bitstream{std::begin(data), std::end(data)};
 
         auto tile_width = bits(4);
         auto tile_height = bits(4);
@@ -342,10 +335,11 @@ void Pkmn_gen1::open(std::istream & input, const Args &)
             copy_and_arrange_buf(buffer_b, buffer_c, tile_width, tile_height, buffer_tile_width, buffer_tile_height);
         }
 
-        set_size(buffer_tile_width * tile_dims, buffer_tile_height * tile_dims);
+        set_size(buffer_tile_width * tile_dims, buffer_tile_height * tile_dims, {std::begin(palette_entries_), std::end(palette_entries_)});
 
         for(auto row = 0u; row < height_; ++row)
         {
+            auto indexes = index_row(row);
             for(auto col = 0u; col < width_; col += tile_dims)
             {
                 auto byte_ind = col / tile_dims * buffer_tile_height * tile_dims + row;
@@ -356,17 +350,14 @@ void Pkmn_gen1::open(std::istream & input, const Args &)
                     auto bit_ind = 7u - i;
                     auto bit0 = (byte0 >> bit_ind) & 0x01;
                     auto bit1 = (byte1 >> bit_ind) & 0x01;
-                    image_data_[row][col + i] = palette_entries_[bit1 << 1 | bit0];
+                    indexes[col + i] = bit1 << 1 | bit0;
                 }
             }
         }
     }
-    catch(std::ios_base::failure & e)
+    catch(const Unexpected_end_of_input &)
     {
-        if(input.bad())
-            throw std::runtime_error{"Error reading Pkmn sprite: could not read file"};
-        else
-            throw std::runtime_error{"Error reading Pkmn sprite: unexpected end of file"};
+        throw std::runtime_error{"Error reading Pkmn sprite: unexpected end of file"};
     }
 }
 
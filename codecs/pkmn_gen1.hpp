@@ -22,6 +22,6 @@ private:
     bool check_overrun_ {true};
     bool fixed_buffer_ {false};
 
-    inline static std::array<Color, 4> palette_entries_;
+    inline static thread_local std::array<Color, 4> palette_entries_; // static for write. Per thread for batch mode
 };
 #endif // PKMN_GEN1_HPP
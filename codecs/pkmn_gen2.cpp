@@ -4,33 +4,34 @@
 #include <map>
 #include <stdexcept>
 
+#include "binio.hpp"
 #include "pkmn_gen1.hpp"
 #include "sub_args.hpp"
 
 constexpr auto tile_dims = 8u;
 constexpr auto tile_bytes = 16u;
 
-void process_cmd(std::istream & input, std::vector<std::uint8_t> & decompressed, std::uint8_t cmd, std::size_t length)
+void process_cmd(Byte_reader & in, std::vector<std::uint8_t> & decompressed, std::uint8_t cmd, std::size_t length)
 {
     switch(cmd)
     {
         case 0x0: // direct copy
         {
-            for(auto i = 0u; i < length; ++i)
-                decompressed.emplace_back(input.get());
+            auto bytes = in.read_span(length);
+            decompressed.insert(std::end(decompressed), std::begin(bytes), std::end(bytes));
             return;
         }
         case 0x1: // byte fill
         {
-            auto v = input.get();
+            auto v = in.get();
             for(auto i = 0u; i < length; ++i)
                 decompressed.emplace_back(v);
             return;
         }
         case 0x2: // word fill
         {
-            auto v1 = input.get();
-            auto v2 = input.get();
+            auto v1 = in.get();
+            auto v2 = in.get();
             for(auto i = 0u; i < length; ++i)
                 decompressed.emplace_back((i % 2 == 0) ? v1 : v2);
             return;
@@ -45,7 +46,7 @@ void process_cmd(std::istream & input, std::vector<std::uint8_t> & decompressed,
         case 0x5: // bit-reverse repeat
         case 0x6: // backwards repeat
         {
-            auto ay = static_cast<std::uint8_t>(input.get());
+            auto ay = in.get();
             auto a = ay >> 7;
             auto y = ay & 0x7fu;
 
@@ -54,7 +55,7 @@ void process_cmd(std::istream & input, std::vector<std::uint8_t> & decompressed,
             if(a)
                 start = std::size(decompressed) - y - 1;
             else
-                start = (y * 0x100) + input.get();
+                start = (y * 0x100) + in.get();
 
             if(start >= std::size(decompressed))
                 throw std::runtime_error{"Pkmn_gen2: start address out of range"};
@@ -100,12 +101,12 @@ void process_cmd(std::istream & input, std::vector<std::uint8_t> & decompressed,
         case 0x7: // long header
         {
             auto sub_cmd = static_cast<std::uint8_t>(((length - 1) & 0x1cu) >> 2);
-            auto sub_length = (((length - 1) & 0x3u) << 8 | input.get()) + 1;
+            auto sub_length = (((length - 1) & 0x3u) << 8 | in.get()) + 1;
 
             if(sub_cmd == 0x07u)
                 throw std::runtime_error{"Pkmn_gen2 LZ3 sub-command is 0x07"};
 
-            process_cmd(input, decompressed, sub_cmd, sub_length);
+            process_cmd(in, decompressed, sub_cmd, sub_length);
             return;
         }
 
@@ -114,20 +115,20 @@ void process_cmd(std::istream & input, std::vector<std::uint8_t> & decompressed,
     }
 }
 
-std::vector<std::uint8_t> lz3_decompress(std::istream & input)
+std::vector<std::uint8_t> lz3_decompress(Byte_reader & in)
 {
     std::vector<std::uint8_t> decompressed;
 
     while(true)
     {
-        auto header = static_cast<std::uint8_t>(input.get());
+        auto header = in.get();
         if(header == 0xff)
             return decompressed;
 
         auto cmd = (header & 0xe0) >> 5;
         auto length = (header & 0x1f) + 1;
 
-        process_cmd(input, decompressed, cmd, length);
+        process_cmd(in, decompressed, cmd, length);
     }
 
     return decompressed;
@@ -135,7 +136,8 @@ std::vector<std::uint8_t> lz3_decompress(std::istream & input)
 
 void Pkmn_gen2::open(std::istream & input, const Args &)
 {
-    input.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+    auto data = read_input_to_memory(input);
+    Byte_reader in{data};
     try
     {
         // So... This isn't actually a real format.
@@ -157,36 +159,33 @@ void Pkmn_gen2::open(std::istream & input, const Args &)
         auto tile_width = static_cast<std::uint8_t>(tile_width_);
         auto tile_height = static_cast<std::uint8_t>(tile_height_);
 
-        auto detect_header = input.get();
-        if(detect_header == 0xff)
+        if(!std::empty(data) && data[0] == 0xff)
         {
-            auto size = static_cast<std::uint8_t>(input.get());
+            in.skip(1);
+            auto size = in.get();
             if(tile_width == 0 || tile_height == 0)
             {
                 tile_width = size >> 4;
                 tile_height = size & 0xf;
             }
 
-            for(auto i = 0; i < 12; ++i)
+            auto palette = in.read_span(12);
+            if(!palette_set_)
             {
-                if(palette_set_)
-                    input.get();
-                else
-                    palette_entries_[i / 3][i % 3] = input.get();
+                for(auto i = 0; i < 12; ++i)
+                    palette_entries_[i / 3][i % 3] = palette[i];
             }
             palette_set_ = true;
         }
-        else
-            input.putback(detect_header);
 
         auto tiles = std::vector<std::uint8_t>{};
         if(uncompressed_)
         {
-            input.exceptions(std::ios_base::badbit); // disable EOF exception
-            tiles = read_input_to_memory(input);
+            auto rest = in.read_span(in.remaining());
+            tiles.assign(std::begin(rest), std::end(rest));
         }
         else
-            tiles = lz3_decompress(input);
+            tiles = lz3_decompress(in);
 
         if(std::size(tiles) % tile_bytes != 0)
             throw std::runtime_error{"Pkmn_gen2 decompressed sprite data has odd size (" + std::to_string(std::size(tiles)) + " bytes)"};
@@ -215,11 +214,11 @@ void Pkmn_gen2::open(std::istream & input, const Args &)
         while(tile_width * tile_height > std::size(tiles) / tile_bytes)
             tiles.emplace_back(0);
 
-        set_size(tile_dims * tile_width, tile_dims * tile_height);
-
         if(!palette_set_)
             palette_entries_ = Pkmn_gen1::palettes.at("greyscale");
 
+        set_size(tile_dims * tile_width, tile_dims * tile_height, {std::begin(palette_entries_), std::end(palette_entries_)});
+
         for(auto i = 0u, tile_col = 0u, row = 0u; i < tile_width * tile_height * tile_bytes; i += 2u, ++row)
         {
             if(row == tile_height * tile_dims)
@@ -232,16 +231,13 @@ void Pkmn_gen2::open(std::istream & input, const Args &)
             {
                 auto bit0 = (tiles[i + 1] >> b) & 0x1;
                 auto bit1 = (tiles[i + 0] >> b) & 0x1;
-                image_data_[row][tile_col * tile_dims + col] = palette_entries_[bit1 << 1 | bit0];
+                index_row(row)[tile_col * tile_dims + col] = bit1 << 1 | bit0;
             }
         }
     }
-    catch(std::ios_base::failure & e)
+    catch(const Unexpected_end_of_input &)
     {
-        if(input.bad())
-            throw std::runtime_error{"Error reading Pkmn sprite: could not read file"};
-        else
-            throw std::runtime_error{"Error reading Pkmn sprite: unexpected end of file"};
+        throw std::runtime_error{"Error reading Pkmn sprite: unexpected end of file"};
     }
 }
 
@@ -24,7 +24,7 @@ struct Libpng
 
     png_structp png_ptr{nullptr};
     png_infop info_ptr{nullptr};
-    inline static std::string error_msg = {"Generic error"};
+    inline static thread_local std::string error_msg = {"Generic error"};
 
     explicit Libpng(Type t):
         type{t}
@@ -349,7 +349,7 @@ void Png::open(std::istream & input, const Args & args)
     libpng.reset();
 
 #ifdef EXIF_FOUND
-    transpose_image(animation_info.orientation);
+    set_orientation(animation_info.orientation);
 #endif
 
     if(animation_info.is_apng && (args.animate || args.image_no))
@@ -372,6 +372,7 @@ void Png::open(std::istream & input, const Args & args)
         frame_delays_.resize(animation_info.num_frames);
 
         auto output_buffer = Image{width_, height_};
+        output_buffer.set_orientation(get_orientation());
 
         // APNG spec calls for starting with transparent black
         for(std::size_t row = 0; row < get_height(); ++row)
@@ -382,6 +383,16 @@ void Png::open(std::istream & input, const Args & args)
 
         auto frame_no = 0u;
 
+        // area cleared by the previous frame's dispose op, which also changes in the following frame. Empty if none
+        Rect disposed_rect;
+
+        // frames are composed un-rotated, so changed areas don't match the rotated display. Don't bother tracking them for rotated images
+    #ifdef EXIF_FOUND
+        const bool track_dirty_rect = animation_info.orientation == exif::Orientation::r_0;
+    #else
+        const bool track_dirty_rect = true;
+    #endif
+
         for(auto i = 0u; i < std::size(animation_info.frame_chunks); ++i)
         {
             auto & fc = animation_info.frame_chunks[i];
@@ -407,10 +418,6 @@ void Png::open(std::istream & input, const Args & args)
                         png_process_data(*libpng, *libpng, const_cast<png_bytep>(std::data(iend)), std::size(iend));
                         libpng.reset();
 
-                    #ifdef EXIF_FOUND
-                        transpose_image(animation_info.orientation);
-                    #endif
-
                         if(composed_)
                         {
                             // the framee's data is in this->image_data_ now, so blend or replace into output_buffer
@@ -440,6 +447,26 @@ void Png::open(std::istream & input, const Args & args)
 
                             images_[frame_no] = output_buffer;
 
+                            if(track_dirty_rect && frame_no > 0)
+                            {
+                                auto dirty = Rect{frame_ctrl.x_offset, frame_ctrl.y_offset, frame_ctrl.width, frame_ctrl.height};
+                                if(disposed_rect.width > 0 && disposed_rect.height > 0)
+                                {
+                                    auto right  = std::max(dirty.x + dirty.width,  disposed_rect.x + disposed_rect.width);
+                                    auto bottom = std::max(dirty.y + dirty.height, disposed_rect.y + disposed_rect.height);
+                                    dirty.x = std::min(dirty.x, disposed_rect.x);
+                                    dirty.y = std::min(dirty.y, disposed_rect.y);
+                                    dirty.width = right - dirty.x;
+                                    dirty.height = bottom - dirty.y;
+                                }
+                                images_[frame_no].set_dirty_rect(dirty);
+                            }
+
+                            if(frame_ctrl.dispose_op != Dispose_op::NONE)
+                                disposed_rect = Rect{frame_ctrl.x_offset, frame_ctrl.y_offset, frame_ctrl.width, frame_ctrl.height};
+                            else
+                                disposed_rect = Rect{};
+
                             // dispose of this frame's data if requested
                             if(frame_ctrl.dispose_op == Dispose_op::BACKGROUND)
                             {
@@ -479,6 +506,8 @@ void Png::open(std::istream & input, const Args & args)
                             }
                             images_[frame_no] = output_buffer;
                         }
+
+                        use_stored_image(frame_no);
                     }
                     frame_ctrl = fc;
 
@@ -519,6 +548,8 @@ void Png::open(std::istream & input, const Args & args)
             }
         }
         libpng.reset();
+
+        deduplicate_frames(args.animate);
     }
     else
     {
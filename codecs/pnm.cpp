@@ -45,6 +45,14 @@ std::uint16_t read_val(std::istream & in)
     }
 }
 
+std::vector<Color> grayscale_palette()
+{
+    std::vector<Color> palette(256);
+    for(std::size_t i = 0; i < std::size(palette); ++i)
+        palette[i] = Color{static_cast<unsigned char>(i)};
+    return palette;
+}
+
 void Pnm::open(std::istream & input, const Args &)
 {
     input.exceptions(std::ios_base::badbit | std::ios_base::failbit);
@@ -65,7 +73,12 @@ void Pnm::open(std::istream & input, const Args &)
         {
             auto width = std::stoull(read_skip_comments(input));
             auto height = std::stoull(read_skip_comments(input));
-            set_size(width, height);
+
+            // grayscale formats are stored 1 byte per pixel
+            if(type == "P1" || type == "P2" || type == "P4" || type == "P5")
+                set_size(width, height, grayscale_palette());
+            else
+                set_size(width, height);
         }
         catch(const std::invalid_argument&)
         {
@@ -127,6 +140,7 @@ void Pnm::read_P1(std::istream & input)
 {
     for(std::size_t row = 0; row < height_; ++row)
     {
+        auto indexes = index_row(row);
         for(std::size_t col = 0; col < width_; ++col)
         {
             int v = 0;
@@ -135,10 +149,10 @@ void Pnm::read_P1(std::istream & input)
             switch(v)
             {
             case '0':
-                image_data_[row][col] = Color{0xFF};
+                indexes[col] = 0xFF;
                 break;
             case '1':
-                image_data_[row][col] = Color{};
+                indexes[col] = 0x00;
                 break;
             default:
                 throw std::runtime_error{"Error reading PBM: unknown character: " + std::string{(char)v}};
@@ -153,6 +167,7 @@ void Pnm::read_P2(std::istream & input)
 
     for(std::size_t row = 0; row < height_; ++row)
     {
+        auto indexes = index_row(row);
         for(std::size_t col = 0; col < width_; ++col)
         {
             auto v = read_val(input);
@@ -160,7 +175,7 @@ void Pnm::read_P2(std::istream & input)
             if(v > max_val)
                 throw std::runtime_error{"Error reading PGM: pixel value out of range"};
 
-            image_data_[row][col] = Color{static_cast<unsigned char>(v / max_val * 255.0f)};
+            indexes[col] = static_cast<unsigned char>(v / max_val * 255.0f);
         }
     }
 }
@@ -195,15 +210,13 @@ void Pnm::read_P4(std::istream & input)
 
     for(std::size_t row = 0; row < height_; ++row)
     {
+        auto indexes = index_row(row);
         for(std::size_t col = 0; col < width_; ++col)
         {
             if(bits_read == 0)
                 bits = input.get();
 
-            if(bits[7 - bits_read])
-                image_data_[row][col] = Color{};
-            else
-                image_data_[row][col] = Color{0xFF};
+            indexes[col] = bits[7 - bits_read] ? 0x00 : 0xFF;
 
             if(++bits_read >= 8)
                 bits_read = 0;
@@ -221,11 +234,12 @@ void Pnm::read_P5(std::istream & input)
 
     for(std::size_t row = 0; row < height_; ++row)
     {
+        auto indexes = index_row(row);
         if(max_val <= std::numeric_limits<std::uint8_t>::max())
         {
-            std::vector<unsigned char> rowbuf(width_);
-            input.read(reinterpret_cast<char *>(std::data(rowbuf)), std::size(rowbuf));
-            std::transform(std::begin(rowbuf), std::end(rowbuf), std::begin(image_data_[row]), [max_val](unsigned char a) { return Color{static_cast<unsigned char>(a / max_val * 255.0f)}; });
+            input.read(reinterpret_cast<char *>(std::data(indexes)), std::size(indexes));
+            if(max_val != std::numeric_limits<std::uint8_t>::max())
+                std::transform(std::begin(indexes), std::end(indexes), std::begin(indexes), [max_val](unsigned char a) { return static_cast<unsigned char>(a / max_val * 255.0f); });
         }
         else
         {
@@ -233,7 +247,7 @@ void Pnm::read_P5(std::istream & input)
             {
                 std::uint16_t val;
                 readb(input, val, std::endian::big);
-                image_data_[row][col] = Color{static_cast<unsigned char>(val / max_val * 255.0f)};
+                indexes[col] = static_cast<unsigned char>(val / max_val * 255.0f);
             }
         }
     }
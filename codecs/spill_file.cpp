@@ -0,0 +1,58 @@
+#include "spill_file.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#include <cerrno>
+#include <cstring>
+
+Spill_file::Spill_file():
+    file_{std::tmpfile()}
+{
+    if(!file_)
+        throw std::runtime_error{"Could not create temporary file for image data: " + std::string{std::strerror(errno)}};
+}
+
+Spill_file::~Spill_file()
+{
+    std::fclose(file_);
+}
+
+std::size_t Spill_file::allocate(std::size_t size)
+{
+    if(auto i = free_.find(size); i != std::end(free_))
+    {
+        auto offset = i->second;
+        free_.erase(i);
+        return offset;
+    }
+
+    auto offset = size_;
+    size_ += size;
+    return offset;
+}
+
+void Spill_file::release(std::size_t offset, std::size_t size)
+{
+    free_.emplace(size, offset);
+}
+
+void Spill_file::write(std::size_t offset, std::span<const Color> data)
+{
+    seek(offset);
+    if(std::fwrite(std::data(data), sizeof(Color), std::size(data), file_) != std::size(data))
+        throw std::runtime_error{"Error writing image data to temporary file: " + std::string{std::strerror(errno)}};
+}
+
+void Spill_file::read(std::size_t offset, std::span<Color> data)
+{
+    seek(offset);
+    if(std::fread(std::data(data), sizeof(Color), std::size(data), file_) != std::size(data))
+        throw std::runtime_error{"Error reading image data from temporary file"};
+}
+
+void Spill_file::seek(std::size_t offset)
+{
+    if(std::fseek(file_, static_cast<long>(offset * sizeof(Color)), SEEK_SET) != 0)
+        throw std::runtime_error{"Error seeking in temporary file: " + std::string{std::strerror(errno)}};
+}
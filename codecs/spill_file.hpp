@@ -0,0 +1,39 @@
+#ifndef SPILL_FILE_HPP
+#define SPILL_FILE_HPP
+
+#include <map>
+#include <span>
+
+#include <cstdio>
+
+#include "../color.hpp"
+
+// Temporary file for pixel data moved out of memory. Space is allocated in
+// runs of Colors, and released runs are reused by later allocations of the
+// same size. The file is deleted when closed
+class Spill_file
+{
+public:
+    Spill_file();
+    ~Spill_file();
+    Spill_file(const Spill_file &) = delete;
+    Spill_file & operator=(const Spill_file &) = delete;
+    Spill_file(Spill_file &&) = delete;
+    Spill_file & operator=(Spill_file &&) = delete;
+
+    // offsets and sizes are in Colors
+    std::size_t allocate(std::size_t size);
+    void release(std::size_t offset, std::size_t size);
+
+    void write(std::size_t offset, std::span<const Color> data);
+    void read(std::size_t offset, std::span<Color> data);
+
+private:
+    void seek(std::size_t offset);
+
+    std::FILE * file_ {nullptr};
+    std::size_t size_ {0};
+    std::multimap<std::size_t, std::size_t> free_; // size -> offset
+};
+
+#endif // SPILL_FILE_HPP
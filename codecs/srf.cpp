@@ -7,6 +7,7 @@
 #include <utility>
 
 #include <cstdint>
+#include <cstring>
 
 #include "binio.hpp"
 #include "sub_args.hpp"
@@ -22,48 +23,45 @@ struct SRF_image
     std::vector<std::uint16_t> image;
 };
 
-SRF_image read_image_data(std::istream & input)
+SRF_image read_image_data(Byte_reader & in)
 {
     // header
-    input.ignore(12); // unknown
+    in.skip(12); // unknown
 
     SRF_image im;
 
-    readb(input, im.height);
-    readb(input, im.width);
+    in.read(im.height);
+    in.read(im.width);
 
-    input.ignore(2); // unknown
+    in.skip(2); // unknown
 
-    std::uint16_t rowstride;
-    readb(input, rowstride);
+    auto rowstride = in.read<std::uint16_t>();
     if(rowstride != im.width * 2)
         throw std::runtime_error{"SRF rowstride mismatched " + std::to_string(rowstride) + " vs " + std::to_string(im.width * 2)};
 
-    input.ignore(4); // unknown
+    in.skip(4); // unknown
 
     // Alpha Mask
-    input.ignore(4); // unknown
+    in.skip(4); // unknown
 
-    std::uint32_t alpha_mask_size;
-    readb(input, alpha_mask_size);
+    auto alpha_mask_size = in.read<std::uint32_t>();
 
     if(alpha_mask_size != im.width * im.height)
         throw std::runtime_error{"SRF alpha size mismatched " + std::to_string(alpha_mask_size) + " vs " + std::to_string(im.width * im.height)};
 
-    im.alpha_mask.resize(im.width * im.height);
-    input.read(reinterpret_cast<char *>(std::data(im.alpha_mask)), std::size(im.alpha_mask) * sizeof(decltype(im.alpha_mask)::value_type));
+    auto alpha_mask = in.read_span(alpha_mask_size);
+    im.alpha_mask.assign(std::begin(alpha_mask), std::end(alpha_mask));
 
     // image data (16-bit)
-    input.ignore(4); // unknown
+    in.skip(4); // unknown
 
-    std::uint32_t image_size;
-    readb(input, image_size);
+    auto image_size = in.read<std::uint32_t>();
     if(image_size != im.width * im.height * 2)
         throw std::runtime_error{"SRF image size mismatched " + std::to_string(image_size) + " vs " + std::to_string(im.width * im.height * 2)};
 
     im.image.resize(im.width * im.height);
     if(image_size)
-        input.read(reinterpret_cast<char *>(std::data(im.image)), std::size(im.image) * sizeof(decltype(im.image)::value_type));
+        std::memcpy(std::data(im.image), std::data(in.read_span(image_size)), image_size);
 
     return im;
 }
@@ -84,30 +82,29 @@ Color get_image_color(std::size_t row,
 constexpr auto frames_per_image = 36u;
 void Srf::open(std::istream & input, const Args & args)
 {
-    input.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+    auto data = read_input_to_memory(input);
+    Byte_reader in{data};
     try
     {
         // header
-        input.ignore(16); // magic
-        input.ignore(8); // unknown
+        in.skip(16); // magic
+        in.skip(8); // unknown
 
-        auto num_images = readb<std::uint32_t>(input);
+        auto num_images = in.read<std::uint32_t>();
 
-        input.ignore(4);
-        std::uint32_t garmin_strlen;
-        readb(input, garmin_strlen);
-        input.ignore(garmin_strlen); // 578 string
+        in.skip(4);
+        auto garmin_strlen = in.read<std::uint32_t>();
+        in.skip(garmin_strlen); // 578 string
 
-        std::uint32_t unknown_switch;
-        readb(input, unknown_switch);
+        auto unknown_switch = in.read<std::uint32_t>();
         if(unknown_switch != 6)
             throw std::runtime_error{"Unsupported SRF image format"};
 
-        readb(input, garmin_strlen);
-        input.ignore(garmin_strlen); // version no
-        input.ignore(4); // unknown
-        readb(input, garmin_strlen);
-        input.ignore(garmin_strlen); // product code?
+        in.read(garmin_strlen);
+        in.skip(garmin_strlen); // version no
+        in.skip(4); // unknown
+        in.read(garmin_strlen);
+        in.skip(garmin_strlen); // product code?
 
         std::vector<SRF_image> image_sets;
 
@@ -116,7 +113,7 @@ void Srf::open(std::istream & input, const Args & args)
 
         for(std::uint32_t i = 0u; i < num_images; ++i)
         {
-            image_sets.emplace_back(read_image_data(input));
+            image_sets.emplace_back(read_image_data(in));
             max_width = std::max(max_width, image_sets.back().width);
             total_height += image_sets.back().height;
         }
@@ -202,12 +199,9 @@ void Srf::open(std::istream & input, const Args & args)
             }
         }
     }
-    catch(std::ios_base::failure & e)
+    catch(const Unexpected_end_of_input &)
     {
-        if(input.bad())
-            throw std::runtime_error{"Error reading SRF: could not read file"};
-        else
-            throw std::runtime_error{"Error reading SRF: unexpected end of file"};
+        throw std::runtime_error{"Error reading SRF: unexpected end of file"};
     }
 }
 
@@ -36,7 +36,7 @@ RsvgHandle * get_svg_handle(std::istream & input, const std::string & filename)
 
     g_object_unref(is);
     g_object_unref(base);
-    data.clear();
+    data = Input_data{};
 
     if(!svg_handle)
     {
@@ -96,16 +96,5 @@ void Svg::open(std::istream & input, const Args & args)
     if(static_cast<std::size_t>(cairo_image_surface_get_stride(bmp)) < width_ * 4)
         throw std::runtime_error {"Invalid SVG stride"};
 
-    for(std::size_t row = 0; row < height_; ++row)
-    {
-        for(std::size_t col = 0; col < width_; ++col)
-        {
-            std::size_t pix_i = cairo_image_surface_get_stride(bmp) * row + 4 * col;
-
-            image_data_[row][col].b = cairo_image_surface_get_data(bmp)[pix_i];
-            image_data_[row][col].g = cairo_image_surface_get_data(bmp)[pix_i + 1];
-            image_data_[row][col].r = cairo_image_surface_get_data(bmp)[pix_i + 2];
-            image_data_[row][col].a = cairo_image_surface_get_data(bmp)[pix_i + 3];
-        }
-    }
+    import_rows(cairo_image_surface_get_data(bmp), cairo_image_surface_get_stride(bmp), Pixel_format::BGRA_premultiplied);
 }
@@ -73,20 +73,20 @@ Color read_pixel(const unsigned char * byte, Tga_data::Color_type color, std::ui
     return {};
 }
 
-Tga_data read_tga_header(std::istream & in)
+Tga_data read_tga_header(Byte_reader & in)
 {
     Tga_data tga;
 
     std::uint8_t id_length;
-    readb(in, id_length);
+    in.read(id_length);
 
     std::uint8_t color_map_type;
-    readb(in, color_map_type);
+    in.read(color_map_type);
     if(color_map_type > 1)
         throw std::runtime_error {"Unsupported TGA color map type: " + std::to_string((int)color_map_type)};
 
     std::uint8_t image_type = 0;
-    readb(in, image_type);
+    in.read(image_type);
     if(    image_type != 1 && image_type != 2  && image_type != 3
         && image_type != 9 && image_type != 10 && image_type != 11)
     {
@@ -98,20 +98,20 @@ Tga_data read_tga_header(std::istream & in)
 
     std::uint16_t color_map_start_idx, color_map_num_entries;
     std::uint8_t color_map_bpp;
-    readb(in, color_map_start_idx);
-    readb(in, color_map_num_entries);
-    readb(in, color_map_bpp);
+    in.read(color_map_start_idx);
+    in.read(color_map_num_entries);
+    in.read(color_map_bpp);
 
     if(color_map_bpp != 0 && color_map_bpp != 8 && color_map_bpp != 15 && color_map_bpp != 16 && color_map_bpp != 24 && color_map_bpp != 32)
         throw std::runtime_error{"Unsupported TGA palette color depth: " + std::to_string((int)color_map_bpp)};
 
-    in.ignore(4); // skip origin
-    readb(in, tga.width);
-    readb(in, tga.height);
-    readb(in, tga.bpp);
+    in.skip(4); // skip origin
+    in.read(tga.width);
+    in.read(tga.height);
+    in.read(tga.bpp);
 
     std::uint8_t image_descriptor;
-    readb(in, image_descriptor);
+    in.read(image_descriptor);
     tga.bottom_to_top = !((image_descriptor & 0x20) >> 5); // if 0, image is upside down
     auto interleaved = (image_descriptor & 0xC0) >> 6;
 
@@ -131,25 +131,21 @@ Tga_data read_tga_header(std::istream & in)
         throw std::runtime_error{"Unsupported TGA color depth in grayscale mode: " + std::to_string((int)tga.bpp)};
 
     // skip image ID block
-    in.ignore(id_length);
+    in.skip(id_length);
 
     if(color_map_type)
     {
         if(tga.color == Tga_data::Color_type::indexed)
         {
             const std::uint8_t num_bytes = (color_map_bpp + 7) / 8; // ceiling division
-            std::vector<char> bytes(num_bytes);
 
             tga.palette.resize(color_map_num_entries);
             for(std::size_t i = color_map_start_idx; i < color_map_num_entries; ++i)
-            {
-                in.read(std::data(bytes), num_bytes);
-                tga.palette[i] = read_pixel(reinterpret_cast<unsigned char *>(std::data(bytes)), Tga_data::Color_type::color, color_map_bpp, {});
-            }
+                tga.palette[i] = read_pixel(std::data(in.read_span(num_bytes)), Tga_data::Color_type::color, color_map_bpp, {});
         }
         else // skip the palette
         {
-            in.ignore((color_map_num_entries - color_map_start_idx) * color_map_bpp / 8);
+            in.skip((color_map_num_entries - color_map_start_idx) * color_map_bpp / 8);
         }
     }
     else if(tga.color == Tga_data::Color_type::indexed)
@@ -160,21 +156,20 @@ Tga_data read_tga_header(std::istream & in)
     return tga;
 }
 
-void read_uncompressed(std::istream & in, const Tga_data & tga, std::vector<std::vector<Color>> & image_data)
+void read_uncompressed(Byte_reader & in, const Tga_data & tga, Pixel_rows & image_data)
 {
-    std::vector<char> rowbuf(tga.width * tga.bpp / 8);
     for(std::size_t row = 0; row < tga.height; ++row)
     {
         auto im_row = tga.bottom_to_top ? tga.height - row - 1 : row;
-        in.read(std::data(rowbuf), std::size(rowbuf));
+        auto rowbuf = in.read_span(tga.width * tga.bpp / 8);
         for(std::size_t col = 0; col < tga.width; ++col)
         {
-            image_data[im_row][col] = read_pixel(reinterpret_cast<unsigned char *>(std::data(rowbuf)) + (col *((tga.bpp + 7) / 8)), tga.color, tga.bpp, tga.palette); // ceiling division
+            image_data[im_row][col] = read_pixel(std::data(rowbuf) + (col *((tga.bpp + 7) / 8)), tga.color, tga.bpp, tga.palette); // ceiling division
         }
     }
 }
 
-void read_compressed(std::istream & in, const Tga_data & tga, std::vector<std::vector<Color>> & image_data)
+void read_compressed(Byte_reader & in, const Tga_data & tga, Pixel_rows & image_data)
 {
     std::size_t row{0};
     auto store_val = [&row, col = std::size_t{0}, im_row = (tga.bottom_to_top ? tga.height - row - 1 : row), &tga, &image_data](const Color & color) mutable
@@ -193,55 +188,47 @@ void read_compressed(std::istream & in, const Tga_data & tga, std::vector<std::v
     };
 
     const std::uint8_t num_bytes = (tga.bpp + 7) / 8; // ceiling division
-    std::vector<char> bytes(num_bytes);
 
     while(row < tga.height)
     {
-        std::uint8_t b;
-        readb(in, b);
+        auto b = in.get();
         auto len = (b & 0x7F) + 1;
 
         if(b & 0x80) // rle packet
         {
-            in.read(std::data(bytes), num_bytes);
-            auto val = read_pixel(reinterpret_cast<unsigned char *>(std::data(bytes)), tga.color, tga.bpp, tga.palette);
+            auto val = read_pixel(std::data(in.read_span(num_bytes)), tga.color, tga.bpp, tga.palette);
 
             for(std::uint8_t i = 0; i < len; ++i)
                 store_val(val);
         }
         else // raw packet
         {
+            auto bytes = in.read_span(len * num_bytes);
             for(std::uint8_t i = 0; i < len; ++i)
-            {
-                in.read(std::data(bytes), num_bytes);
-                auto val = read_pixel(reinterpret_cast<unsigned char *>(std::data(bytes)), tga.color, tga.bpp, tga.palette);
-                store_val(val);
-            }
+                store_val(read_pixel(std::data(bytes) + i * num_bytes, tga.color, tga.bpp, tga.palette));
         }
     }
 }
 
 void Tga::open(std::istream & input, const Args &)
 {
-    input.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+    auto data = read_input_to_memory(input);
+    Byte_reader in{data};
     try
     {
-        auto tga = read_tga_header(input);
+        auto tga = read_tga_header(in);
 
         set_size(tga.width, tga.height);
 
         if(tga.rle_compressed)
-            read_compressed(input, tga, image_data_);
+            read_compressed(in, tga, image_data_);
         else
-            read_uncompressed(input, tga, image_data_);
+            read_uncompressed(in, tga, image_data_);
 
     }
-    catch(std::ios_base::failure & e)
+    catch(const Unexpected_end_of_input &)
     {
-        if(input.bad())
-            throw std::runtime_error{"Error reading TGA: could not read file"};
-        else
-            throw std::runtime_error{"Error reading TGA: unexpected end of file"};
+        throw std::runtime_error{"Error reading TGA: unexpected end of file"};
     }
 }
 
@@ -7,14 +7,23 @@
 #include <tiff.h>
 #include <tiffio.h>
 
-struct Tiff_io
+struct Tiff_reader
 {
-    Tiff_io() = default;
+    explicit Tiff_reader(std::istream & input):
+        input{input}
+    {
+        input.seekg(0, std::ios_base::end);
+        size = input.tellg() - start;
+        input.seekg(start);
+    }
 
-    explicit Tiff_io(std::istream & input):
-        data { Image::read_input_to_memory(input) }
-    {}
+    std::istream & input;
+    std::istream::pos_type start {input.tellg()};
+    std::size_t size {0};
+};
 
+struct Tiff_io
+{
     void write(std::ostream & out) const
     {
         out.write(reinterpret_cast<const char *>(std::data(data)), std::size(data));
@@ -26,11 +35,64 @@ struct Tiff_io
 
 tsize_t tiff_read(thandle_t hnd, tdata_t data, tsize_t size)
 {
-    auto io = reinterpret_cast<Tiff_io*>(hnd);
-    auto read_size = std::min(static_cast<size_t>(size), std::size(io->data) - io->pos);
-    std::memcpy(data, std::data(io->data) + io->pos, read_size);
-    io->pos += read_size;
-    return read_size;
+    auto io = reinterpret_cast<Tiff_reader*>(hnd);
+    io->input.read(static_cast<char *>(data), size);
+    auto count = io->input.gcount();
+
+    // hitting EOF sets failbit, which would keep seeking from working
+    io->input.clear();
+
+    return count;
+}
+
+toff_t tiff_read_seek(thandle_t hnd, toff_t off, int whence)
+{
+    auto io = reinterpret_cast<Tiff_reader*>(hnd);
+    switch(whence)
+    {
+        case SEEK_SET:
+            io->input.seekg(io->start + static_cast<std::streamoff>(off));
+            break;
+        case SEEK_CUR:
+            io->input.seekg(static_cast<std::streamoff>(off), std::ios_base::cur);
+            break;
+        case SEEK_END:
+            io->input.seekg(io->start + static_cast<std::streamoff>(io->size - off));
+    }
+
+    if(!io->input)
+    {
+        io->input.clear();
+        return static_cast<toff_t>(-1);
+    }
+
+    return io->input.tellg() - io->start;
+}
+
+toff_t tiff_read_size(thandle_t hnd)
+{
+    auto io = reinterpret_cast<Tiff_reader*>(hnd);
+    return io->size;
+}
+
+// lets libtiff read strips straight out of the data, instead of copying them out through tiff_read.
+// An Input_source has all of the data in memory, either memory mapped, or spooled to a mapped temp file.
+// libtiff doesn't write to files opened for reading, so handing it read-only data is safe
+int tiff_read_map(thandle_t hnd, tdata_t * base, toff_t * size)
+{
+    auto io = reinterpret_cast<Tiff_reader*>(hnd);
+    auto source = dynamic_cast<Input_source *>(io->input.rdbuf());
+    if(!source)
+        return 0;
+
+    auto contents = source->contents();
+    auto start = static_cast<std::size_t>(io->start);
+    if(start + io->size > std::size(contents))
+        return 0;
+
+    *base = const_cast<unsigned char *>(std::data(contents) + start);
+    *size = io->size;
+    return 1;
 }
 
 tsize_t tiff_write(thandle_t hnd, tdata_t data, tsize_t size)
@@ -74,13 +136,14 @@ toff_t tiff_size(thandle_t hnd)
 
 void Tiff::open(std::istream & input, const Args &)
 {
-    // libtiff does kind of a stupid thing and will seek backwards, which Header_stream doesn't support (because we can read from a pipe)
-    // read the whole, huge file into memory instead
-    Tiff_io tiff_reader(input);
+    // libtiff seeks backwards, so this relies on input being seekable. Input_source is, even when reading from a pipe
+    Tiff_reader tiff_reader(input);
+    if(!input)
+        throw std::runtime_error{"Error reading TIFF data"};
 
     TIFFSetWarningHandler(nullptr);
 
-    auto tiff = TIFFClientOpen("TIFF", "r", &tiff_reader, tiff_read, [](auto,auto,auto){return tsize_t{0};}, tiff_seek, [](auto){return 0;}, tiff_size, [](auto,auto,auto){return 0;}, [](auto,auto,auto){});
+    auto tiff = TIFFClientOpen("TIFF", "r", &tiff_reader, tiff_read, [](auto,auto,auto){return tsize_t{0};}, tiff_read_seek, [](auto){return 0;}, tiff_read_size, tiff_read_map, [](auto,auto,auto){});
     if(!tiff)
         throw std::runtime_error{"Error reading TIFF data"};
 
@@ -98,17 +161,7 @@ void Tiff::open(std::istream & input, const Args &)
 
     set_size(w, h);
 
-    for(std::size_t row = 0; row < height_; ++row)
-    {
-        for(std::size_t col = 0; col < width_; ++col)
-        {
-            auto pix = raster[row * width_ + col];
-            image_data_[row][col].r = TIFFGetR(pix);
-            image_data_[row][col].g = TIFFGetG(pix);
-            image_data_[row][col].b = TIFFGetB(pix);
-            image_data_[row][col].a = TIFFGetA(pix);
-        }
-    }
+    import_rows(std::data(raster), width_ * sizeof(std::uint32_t), Pixel_format::ABGR_32);
 
     TIFFClose(tiff);
 }
@@ -138,12 +191,7 @@ void Tiff::write(std::ostream & out, const Image & img, bool invert)
     std::vector<Color> rowbuf(img.get_width());
     for(std::size_t row = 0; row < img.get_height(); ++row)
     {
-        for(std::size_t col = 0; col < img.get_width(); ++col)
-        {
-            rowbuf[col] = img[row][col];
-            if(invert)
-                rowbuf[col].invert();
-        }
+        img.export_rows(std::data(rowbuf), 0, Pixel_format::RGBA, invert, row, 1);
         if(TIFFWriteScanline(tiff, std::data(rowbuf), row, 0) < 0)
         {
             TIFFClose(tiff);
@@ -6,6 +6,7 @@
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <utility>
 
 #include <cstring>
 #include <climits>
@@ -684,9 +685,11 @@ void Xpm::open(std::istream & input, const Args &)
 {
     My_XpmImage img;
 
+    // libXpm wants a mutable, null-terminated buffer
     auto data = Image::read_input_to_memory(input);
+    auto buffer = std::string(std::begin(data), std::end(data));
 
-    if(XpmCreateXpmImageFromBuffer(reinterpret_cast<char *>(std::data(data)), &img, nullptr) != XpmSuccess)
+    if(XpmCreateXpmImageFromBuffer(std::data(buffer), &img, nullptr) != XpmSuccess)
         throw std::runtime_error {"Error: Invalid XPM file"};
 
     std::vector<Color> colors;
@@ -765,6 +768,7 @@ void Xpm::open(std::istream & input, const Args &)
             image_data_[row][col] = colors[img.data[row * width_ + col]];
         }
     }
+    set_source_palette(std::move(colors));
 }
 
 template <typename T>
@@ -1,12 +1,17 @@
 #include "display.hpp"
 
 #include <algorithm>
+#include <array>
+#include <charconv>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <optional>
-#include <sstream>
 #include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <cmath>
 #include <cstring>
@@ -14,17 +19,19 @@
 #include "animate.hpp"
 #include "color.hpp"
 #include "font.hpp"
+#include "thread_pool.hpp"
 
 #define ESC "\x1B"
 #define CSI ESC "["
 #define SEP ";"
 #define SGR "m"
+#define CUP "H"
 #define RESET_CHAR CSI "0" SGR
 #define FG24 "38;2;"
 #define BG24 "48;2;"
 #define FG8 "38;5;"
 #define BG8 "48;5;"
-#define UPPER_HALF_BLOCK "▀";
+#define UPPER_HALF_BLOCK "▀"
 
 namespace
 {
@@ -79,143 +86,314 @@ namespace
 
     constexpr auto color_table = build_color_table();
 
-    class set_color
+    // index of a color in the display palette, as std::find on color_table would give
+    template <Args::Color color_type>
+    std::size_t palette_index(const Color & c)
     {
-    public:
-        explicit set_color(const std::optional<Color> & fg_color, const std::optional<Color> & bg_color, Args::Color color_type)
+        static_assert(color_type == Args::Color::ANSI4 || color_type == Args::Color::ANSI8);
+        constexpr std::size_t palette_size = color_type == Args::Color::ANSI4 ? 16 : std::size(color_table);
+
+        static const auto indexes = []
         {
-            if(color_type != Args::Color::NONE && color_type != Args::Color::ANSI4 && color_type != Args::Color::ANSI8 && color_type != Args::Color::ANSI24)
-                throw std::runtime_error{"Unsupported set_color mode"};
+            std::unordered_map<Color, std::size_t> indexes;
+            for(std::size_t i = 0; i < palette_size; ++i)
+                indexes.emplace(color_table[i], i); // keeps the first index of any repeated color
+            return indexes;
+        }();
+
+        auto i = indexes.find(c);
+        return i == std::end(indexes) ? palette_size : i->second;
+    }
 
-            enum class Color_mode {none, fg_only, bg_only, both} color_mode;
+    void append_number(std::string & out, std::size_t n)
+    {
+        std::array<char, 20> buf;
+        auto end = std::to_chars(std::data(buf), std::data(buf) + std::size(buf), n).ptr;
+        out.append(std::data(buf), end);
+    }
 
-            if(!fg_color && !bg_color)
-                color_mode = Color_mode::none;
+    // the part of an SGR sequence setting one color
+    template <Args::Color color_type, bool background>
+    void append_color_code(std::string & out, const Color & c)
+    {
+        if constexpr(color_type == Args::Color::ANSI24)
+        {
+            out += background ? BG24 : FG24;
+            append_number(out, c.r);
+            out += SEP;
+            append_number(out, c.g);
+            out += SEP;
+            append_number(out, c.b);
+        }
+        else if constexpr(color_type == Args::Color::ANSI8)
+        {
+            out += background ? BG8 : FG8;
+            append_number(out, palette_index<color_type>(c));
+        }
+        else if constexpr(color_type == Args::Color::ANSI4)
+        {
+            auto i = palette_index<color_type>(c);
+            if(i >= 8 && i < 16)
+                i += 60 - 8;
+            append_number(out, i + (background ? 40 : 30));
+        }
+    }
 
-            else if(fg_color && !bg_color)
-                color_mode = Color_mode::fg_only;
+    template <Args::Color color_type, bool has_fg, bool has_bg>
+    void append_set_color(std::string & out, const Color & fg_color, const Color & bg_color)
+    {
+        if constexpr(color_type != Args::Color::NONE && (has_fg || has_bg))
+        {
+            out += CSI;
+            if constexpr(has_fg)
+                append_color_code<color_type, false>(out, fg_color);
+            if constexpr(has_fg && has_bg)
+                out += SEP;
+            if constexpr(has_bg)
+                append_color_code<color_type, true>(out, bg_color);
+            out += SGR;
+        }
+    }
 
-            else if(!fg_color && fg_color)
-                color_mode = Color_mode::bg_only;
+    // finding and rendering the font is slow, so it's only done once for each font.
+    // Shared by all threads, for batch mode
+    Char_vals load_char_vals(const Args & args)
+    {
+        static std::mutex mutex;
+        static std::map<std::pair<std::string, float>, Char_vals> loaded;
 
-            else
-                color_mode = Color_mode::both;
+        std::lock_guard lock{mutex};
+        auto key = std::pair{args.font_name, args.font_size};
+        if(auto found = loaded.find(key); found != std::end(loaded))
+            return found->second;
 
-            std::ostringstream os;
+        auto font_path = get_font_path(args.font_name);
+        return loaded.emplace(key, get_char_values(font_path, args.font_size)).first->second;
+    }
+
+    std::pair<std::size_t, std::size_t> get_scaled_size(const Image_view & img, const Args & args)
+    {
+        int rows = 0, cols = get_display_cols(img, args);
+
+        if(!args.rows)
+            rows = -1;
+        else
+            rows = *args.rows;
+
+        auto disp_height = rows > 0 ? rows : img.get_height() * cols / img.get_width() / 2;
+        if(args.disp_char == Args::Disp_char::HALF_BLOCK)
+            disp_height *= 2;
+
+        return {cols, disp_height};
+    }
+
+    // invert and blend with background
+    Color process_color(const Color & c, const Args & args)
+    {
+        FColor disp_c {c};
+
+        if(args.invert)
+            disp_c.invert();
 
-            if(color_type == Args::Color::ANSI24)
+        disp_c.alpha_blend(args.bg / 255.0f);
+
+        return disp_c;
+    }
+
+    void process_colors(Image & scaled_img, const Args & args, const Image::Rect & region)
+    {
+        for(std::size_t row = region.y; row < region.y + region.height; ++row)
+        {
+            auto & pixels = scaled_img[row];
+            for(std::size_t col = region.x; col < region.x + region.width; ++col)
+                pixels[col] = process_color(pixels[col], args);
+        }
+    }
+
+    // reduce colors to those available in the selected palette
+    auto get_palette_end(const Args & args)
+    {
+        return args.color == Args::Color::ANSI4 ? std::begin(color_table) + 16 : std::end(color_table);
+    }
+
+    // Map each color of a paletted source (after processing) to the display palette once.
+    // Cells where scaling didn't blend source colors are then translated directly, and
+    // only blended cells need to be matched and dithered
+    Image::Color_map get_exact_colors(const std::vector<Color> & source_palette, const Args & args)
+    {
+        constexpr auto max_source_palette_size = 256u;
+
+        Image::Color_map exact_colors;
+        if((args.color != Args::Color::ANSI8 && args.color != Args::Color::ANSI4) || std::size(source_palette) > max_source_palette_size)
+            return exact_colors;
+
+        for(auto && c: source_palette)
+        {
+            auto processed = process_color(c, args);
+            exact_colors.emplace(processed, *std::min_element(std::begin(color_table), get_palette_end(args), [processed](const Color & a, const Color & b)
             {
-                switch(color_mode)
-                {
-                    case Color_mode::none:
-                        break;
-                    case Color_mode::fg_only:
-                        os << CSI FG24 << static_cast<int>(fg_color->r) << SEP << static_cast<int>(fg_color->g) << SEP << static_cast<int>(fg_color->b) <<SGR;
-                        break;
-                    case Color_mode::bg_only:
-                        os << CSI BG24 << static_cast<int>(bg_color->r) << SEP << static_cast<int>(bg_color->g) << SEP << static_cast<int>(bg_color->b) << SGR;
-                        break;
-                    case Color_mode::both:
-                        os << CSI FG24 << static_cast<int>(fg_color->r) << SEP << static_cast<int>(fg_color->g) << SEP << static_cast<int>(fg_color->b)
-                        << SEP BG24 << static_cast<int>(bg_color->r) << SEP << static_cast<int>(bg_color->g) << SEP << static_cast<int>(bg_color->b) << SGR;
-                        break;
-                }
-            }
-            else if(color_type == Args::Color::ANSI8)
+                return color_dist2(a, processed) < color_dist2(b, processed);
+            }));
+        }
+
+        return exact_colors;
+    }
+
+    void apply_palette(Image & scaled_img, const Args & args, const Image::Color_map & exact_colors = {}, Thread_pool * pool = nullptr)
+    {
+        if(args.color == Args::Color::ANSI8 || args.color == Args::Color::ANSI4)
+            scaled_img.dither(std::begin(color_table), get_palette_end(args), exact_colors, pool);
+    }
+
+    // as above, but keep cells unchanged from the previous frame stable
+    void apply_palette(Image & scaled_img, const Args & args, const Image::Rect & region, const Image & previous, const Image & previous_dithered, const Image::Color_map & exact_colors = {})
+    {
+        if(args.color == Args::Color::ANSI8 || args.color == Args::Color::ANSI4)
+            scaled_img.dither(std::begin(color_table), get_palette_end(args), region, previous, previous_dithered, exact_colors);
+    }
+
+    // pools are kept for later images, one for each thread count asked for. Only one image may use a pool at a time,
+    // so images rendered concurrently (as in batch) use --threads 1, whose pool runs everything on the caller
+    Thread_pool & get_thread_pool(const Args & args)
+    {
+        static std::mutex mutex;
+        static std::map<unsigned int, Thread_pool> pools;
+
+        const auto threads = args.threads.value_or(0u);
+        std::lock_guard lock{mutex};
+        return pools.try_emplace(threads, threads).first->second;
+    }
+
+    // split an image into horizontal bands of whole display lines to work on in parallel. A few bands per thread
+    // evens out bands that take longer than others
+    std::vector<Image::Rect> get_bands(const Image & scaled_img, const Args & args, std::size_t num_threads)
+    {
+        constexpr std::size_t bands_per_thread = 4;
+
+        const std::size_t rows_per_line = args.disp_char == Args::Disp_char::HALF_BLOCK ? 2 : 1;
+        const auto lines = (scaled_img.get_height() + rows_per_line - 1) / rows_per_line;
+        const auto num_bands = std::min(lines, num_threads * bands_per_thread);
+
+        std::vector<Image::Rect> bands;
+        for(std::size_t i = 0; i < num_bands; ++i)
+        {
+            auto top = lines * i / num_bands * rows_per_line;
+            auto bottom = std::min(scaled_img.get_height(), lines * (i + 1) / num_bands * rows_per_line);
+            bands.push_back({0, top, scaled_img.get_width(), bottom - top});
+        }
+
+        return bands;
+    }
+
+    // print the given region of display cells. When previous is given, only
+    // cells that differ from it are printed, positioning the cursor for each
+    // changed span instead of separating rows with newlines.
+    // Instantiated for each display mode, so the per-cell loop doesn't branch on it
+    template <Args::Disp_char disp_char, Args::Color color_type>
+    void print_cells(const Image & scaled_img, const Char_vals & char_vals, std::string & out, const Image::Rect & region, const Image * previous)
+    {
+        constexpr std::size_t rows_per_line = disp_char == Args::Disp_char::HALF_BLOCK ? 2 : 1;
+
+        for(std::size_t row = region.y / rows_per_line; row < (region.y + region.height) / rows_per_line; ++row)
+        {
+            auto start_col = region.x, end_col = region.x + region.width;
+
+            if(previous)
             {
-                switch(color_mode)
+                auto changed = [&](std::size_t col)
                 {
-                    case Color_mode::none:
-                        break;
-                    case Color_mode::fg_only:
-                        os << CSI FG8 << std::distance(std::begin(color_table), std::find(std::begin(color_table), std::end(color_table), *fg_color)) << SGR;
-                        break;
-                    case Color_mode::bg_only:
-                        os << CSI BG8<< std::distance(std::begin(color_table), std::find(std::begin(color_table), std::end(color_table), *bg_color)) << SGR;
-                        break;
-                    case Color_mode::both:
-                        os << CSI FG8 << std::distance(std::begin(color_table), std::find(std::begin(color_table), std::end(color_table), *fg_color))
-                        << SEP BG8 << std::distance(std::begin(color_table), std::find(std::begin(color_table), std::end(color_table), *bg_color)) << SGR;
-                        break;
-                }
+                    for(auto i = row * rows_per_line; i < (row + 1) * rows_per_line; ++i)
+                    {
+                        if(scaled_img[i][col] != (*previous)[i][col])
+                            return true;
+                    }
+                    return false;
+                };
+
+                while(start_col < end_col && !changed(start_col))
+                    ++start_col;
+                while(end_col > start_col && !changed(end_col - 1))
+                    --end_col;
+
+                if(start_col == end_col)
+                    continue;
+
+                out += CSI;
+                append_number(out, row + 1);
+                out += SEP;
+                append_number(out, start_col + 1);
+                out += CUP;
             }
-            else if(color_type == Args::Color::ANSI4)
-            {
-                std::array<int, 2> index {};
 
-                if(fg_color)
-                    index[0] = std::distance(std::begin(color_table), std::find(std::begin(color_table), std::begin(color_table) + 16, *fg_color));
-                if(bg_color)
-                    index[1] = std::distance(std::begin(color_table), std::find(std::begin(color_table), std::begin(color_table) + 16, *bg_color));
+            const auto & upper = scaled_img[row * rows_per_line];
+            const auto & lower = scaled_img[row * rows_per_line + rows_per_line - 1];
 
-                for(auto && i: index)
+            for(std::size_t col = start_col; col < end_col; ++col)
+            {
+                if constexpr(disp_char == Args::Disp_char::HALF_BLOCK)
                 {
-                    if(i >= 8 && i < 16)
-                        i += 60 - 8;
-                    else if(i >= 17)
-                        throw std::logic_error{"ASNI4 index out of range"};
+                    append_set_color<color_type, true, true>(out, upper[col], lower[col]);
+                    out += UPPER_HALF_BLOCK;
                 }
-
-                index[0] += 30;
-                index[1] += 40;
-
-                switch(color_mode)
+                else if constexpr(disp_char == Args::Disp_char::SPACE)
+                {
+                    append_set_color<color_type, false, true>(out, {}, upper[col]);
+                    out += ' ';
+                }
+                else if constexpr(disp_char == Args::Disp_char::ASCII)
                 {
-                    case Color_mode::none:
-                        break;
-                    case Color_mode::fg_only:
-                        os << CSI << index[0] << SGR;
-                        break;
-                    case Color_mode::bg_only:
-                        os << CSI << index[1] << SGR;
-                        break;
-                    case Color_mode::both:
-                        os << CSI << index[0]
-                        << SEP << index[1] << SGR;
-                        break;
+                    append_set_color<color_type, true, false>(out, upper[col], {});
+                    out += char_vals[static_cast<unsigned char>(FColor{upper[col]}.to_gray() * 255.0f)];
                 }
             }
 
-            command_ = os.str();
+            if constexpr(color_type != Args::Color::NONE)
+                out += RESET_CHAR;
+            if(!previous)
+                out += '\n';
         }
+    }
 
-        friend std::ostream & operator<<(std::ostream &os, const set_color & sc)
+    using Print_cells_fun = void (*)(const Image &, const Char_vals &, std::string &, const Image::Rect &, const Image *);
+
+    template <Args::Disp_char disp_char>
+    Print_cells_fun get_print_cells(Args::Color color_type)
+    {
+        switch(color_type)
         {
-            return os << sc.command_;
+            case Args::Color::NONE:   return print_cells<disp_char, Args::Color::NONE>;
+            case Args::Color::ANSI4:  return print_cells<disp_char, Args::Color::ANSI4>;
+            case Args::Color::ANSI8:  return print_cells<disp_char, Args::Color::ANSI8>;
+            case Args::Color::ANSI24: return print_cells<disp_char, Args::Color::ANSI24>;
         }
+        throw std::runtime_error{"Unsupported color mode"};
+    }
 
-    private:
-        std::string command_;
-    };
-
-    std::ostream & clear_color(std::ostream & os)
+    Print_cells_fun get_print_cells(const Args & args)
     {
-        return os << RESET_CHAR;
+        switch(args.disp_char)
+        {
+            case Args::Disp_char::HALF_BLOCK: return get_print_cells<Args::Disp_char::HALF_BLOCK>(args.color);
+            case Args::Disp_char::SPACE:      return get_print_cells<Args::Disp_char::SPACE>(args.color);
+            case Args::Disp_char::ASCII:      return get_print_cells<Args::Disp_char::ASCII>(args.color);
+        }
+        throw std::runtime_error{"Unsupported display mode"};
     }
 }
 
-void display_image(const Image & img, const Args & args)
+void display_image(const Image & img, const Args & args, std::ostream & standard_out)
 {
     if(args.animate)
     {
         auto animator = Animate{args};
-        do
-        {
-            for(auto f = 0u; f < img.num_frames(); ++f)
-            {
-                animator.set_frame_delay(args.animation_frame_delay > 0.0f ? std::chrono::duration<float>(args.animation_frame_delay) : img.get_frame_delay(f));
-                animator.display(img.get_frame(f));
-                if(!animator)
-                    break;
-            }
-        } while(animator && args.loop_animation);
+        animator.play(img);
     }
     else
     {
         std::ofstream output_file;
         if(args.output_filename != "-")
             output_file.open(args.output_filename);
-        std::ostream & out = args.output_filename == "-" ? std::cout : output_file;
+        std::ostream & out = args.output_filename == "-" ? standard_out : output_file;
 
         if(!out)
             throw std::runtime_error{"Could not open output file " + (args.output_filename == "-" ? "" : ("(" + args.output_filename + ") ")) + ": " + std::string{std::strerror(errno)}};
@@ -227,83 +405,138 @@ void display_image(const Image & img, const Args & args)
     }
 }
 
-void print_image(const Image & img, const Args & args, std::ostream & out)
+void print_image(const Image_view & img, const Args & args, std::ostream & out)
 {
     if(img.get_width() == 0 || img.get_height() == 0)
         return;
 
     Char_vals char_vals;
     if(args.disp_char == Args::Disp_char::ASCII)
+        char_vals = load_char_vals(args);
+
+    auto [cols, disp_height] = get_scaled_size(img, args);
+    auto scaled_img = Image{cols, disp_height};
+
+    auto & pool = get_thread_pool(args);
+    const auto bands = get_bands(scaled_img, args, pool.size());
+    const auto print_cells = get_print_cells(args);
+    std::vector<std::string> band_output(std::size(bands));
+    auto print_band = [&](std::size_t i) { print_cells(scaled_img, char_vals, band_output[i], bands[i], nullptr); };
+
+    const auto reduce_colors = args.color == Args::Color::ANSI8 || args.color == Args::Color::ANSI4;
+
+    // without palette reduction, each band is taken all the way through on one thread
+    img.make_resident();
+    pool.parallel_for(std::size(bands), [&](std::size_t i)
     {
-        auto font_path = get_font_path(args.font_name);
-        char_vals = get_char_values(font_path, args.font_size);
+        img.scale_region(scaled_img, bands[i]);
+        process_colors(scaled_img, args, bands[i]);
+        if(!reduce_colors)
+            print_band(i);
+    });
+
+    // dithering spreads error across bands, so it runs over the whole image in between
+    if(reduce_colors)
+    {
+        apply_palette(scaled_img, args, get_exact_colors(img.get_source_palette(), args), &pool);
+        pool.parallel_for(std::size(bands), print_band);
     }
 
-    int rows = 0, cols = 0;
+    for(auto && band: band_output)
+        out << band;
+}
 
-    if(!args.cols)
-        cols = std::min({80, get_screen_cols(), static_cast<int>(img.get_width())});
-    else
-        cols = *args.cols;
+void Frame_display::print(const Image & img, const Args & args, std::ostream & out, bool follows_previous)
+{
+    if(img.get_width() == 0 || img.get_height() == 0)
+        return;
 
-    if(!args.rows)
-        rows = -1;
-    else
-        rows = *args.rows;
+    if(args.disp_char == Args::Disp_char::ASCII && !char_vals_)
+        char_vals_ = load_char_vals(args);
 
-    const auto bg = args.bg / 255.0f;
-    auto disp_height = rows > 0 ? rows : img.get_height() * cols / img.get_width() / 2;
-    if(args.disp_char == Args::Disp_char::HALF_BLOCK)
-        disp_height *= 2;
+    auto [cols, disp_height] = get_scaled_size(img, args);
 
-    auto scaled_img = img.scale(cols, disp_height);
+    // the scaler reads indexed data as it is
+    img.make_resident(true);
 
-    for(std::size_t row = 0; row < scaled_img.get_height(); ++row)
+    if(!valid_ || args.color != color_ || args.disp_char != disp_char_
+        || displayed_.get_width() != cols || displayed_.get_height() != disp_height)
     {
-        for(std::size_t col = 0; col < scaled_img.get_width(); ++col)
-        {
-            FColor disp_c {scaled_img[row][col]};
+        processed_ = img.scale(cols, disp_height);
+        const auto full = Image::Rect{0, 0, processed_.get_width(), processed_.get_height()};
+        process_colors(processed_, args, full);
+
+        displayed_ = processed_;
+        apply_palette(displayed_, args, get_exact_colors(img.get_source_palette(), args));
+        std::string output;
+        get_print_cells(args)(displayed_, char_vals_.value_or(Char_vals{}), output, full, nullptr);
+        out << output;
+
+        color_ = args.color;
+        disp_char_ = args.disp_char;
+        valid_ = true;
+        return;
+    }
 
-            if(args.invert)
-                disp_c.invert();
+    auto region = Image::Rect{0, 0, cols, disp_height};
+
+    // find the display cells covering the changed part of the source image
+    if(auto & dirty = img.get_dirty_rect(); dirty && follows_previous)
+    {
+        const auto px_col = static_cast<float>(img.get_width())  / static_cast<float>(cols);
+        const auto px_row = static_cast<float>(img.get_height()) / static_cast<float>(disp_height);
 
-            disp_c.alpha_blend(bg);
+        // pad by a cell on each side to cover any rounding in the scaler
+        auto left   = static_cast<std::size_t>(std::max(0.0f, std::floor(static_cast<float>(dirty->x) / px_col) - 1.0f));
+        auto top    = static_cast<std::size_t>(std::max(0.0f, std::floor(static_cast<float>(dirty->y) / px_row) - 1.0f));
+        auto right  = std::min(cols,        static_cast<std::size_t>(std::ceil(static_cast<float>(dirty->x + dirty->width)  / px_col) + 1.0f));
+        auto bottom = std::min(disp_height, static_cast<std::size_t>(std::ceil(static_cast<float>(dirty->y + dirty->height) / px_row) + 1.0f));
 
-            scaled_img[row][col] = disp_c;
+        // each half-block character covers 2 rows
+        if(args.disp_char == Args::Disp_char::HALF_BLOCK)
+        {
+            top -= top % 2;
+            bottom = std::min(disp_height, bottom + bottom % 2);
         }
+
+        if(left >= right || top >= bottom)
+            return;
+
+        region = Image::Rect{left, top, right - left, bottom - top};
     }
 
-    if(args.color == Args::Color::ANSI8)
-        scaled_img.dither(std::begin(color_table), std::end(color_table));
-    else if(args.color == Args::Color::ANSI4)
-        scaled_img.dither(std::begin(color_table), std::begin(color_table) + 16);
+    std::swap(previous_processed_, processed_);
+    processed_ = previous_processed_;
+    img.scale_region(processed_, region);
+    process_colors(processed_, args, region);
 
-    for(std::size_t row = 0; row < (args.disp_char == Args::Disp_char::HALF_BLOCK ? scaled_img.get_height() / 2 : scaled_img.get_height()); ++row)
-    {
-        for(std::size_t col = 0; col < scaled_img.get_width(); ++col)
-        {
-            switch(args.disp_char)
-            {
-                case Args::Disp_char::HALF_BLOCK:
-                    out<<set_color(scaled_img[row * 2][col], scaled_img[row * 2 + 1][col], args.color) << UPPER_HALF_BLOCK;
-                    break;
+    std::swap(previous_displayed_, displayed_);
+    displayed_ = previous_displayed_;
+    for(std::size_t row = region.y; row < region.y + region.height; ++row)
+        std::copy(std::begin(processed_[row]) + region.x, std::begin(processed_[row]) + region.x + region.width, std::begin(displayed_[row]) + region.x);
 
-                case Args::Disp_char::SPACE:
-                    out<<set_color({}, scaled_img[row][col], args.color) << " ";
-                    break;
+    apply_palette(displayed_, args, region, previous_processed_, previous_displayed_, get_exact_colors(img.get_source_palette(), args));
+    std::string output;
+    get_print_cells(args)(displayed_, char_vals_.value_or(Char_vals{}), output, region, &previous_displayed_);
+    out << output;
+}
 
-                case Args::Disp_char::ASCII:
-                {
-                    auto color = scaled_img[row][col];
-                    auto disp_char = char_vals[static_cast<unsigned char>(FColor{color}.to_gray() * 255.0f)];
-                    out<<set_color(color, {}, args.color) << disp_char;
-                    break;
-                }
-            }
-        }
+void Frame_display::invalidate()
+{
+    valid_ = false;
+}
 
-        if(args.color != Args::Color::NONE)
-            out<<clear_color;
-        out<<'\n';
-    }
+void preload_display(const Args & args)
+{
+    load_char_vals(args);
+    palette_index<Args::Color::ANSI4>(Color{});
+    palette_index<Args::Color::ANSI8>(Color{});
+}
+
+int get_display_cols(const Image_view & img, const Args & args)
+{
+    if(!args.cols)
+        return std::min({80, get_screen_cols(), static_cast<int>(img.get_width())});
+    else
+        return *args.cols;
 }
@@ -1,10 +1,40 @@
 #ifndef DISPLAY_HPP
 #define DISPLAY_HPP
 
+#include <optional>
+
 #include "args.hpp"
+#include "font.hpp"
 #include "codecs/image.hpp"
 
-void display_image(const Image & img, const Args & args);
-void print_image(const Image & img, const Args & args, std::ostream & out);
+// Keeps what was last printed, so that following animation frames only need to
+// re-render and print the cells that changed
+class Frame_display
+{
+public:
+    // set follows_previous to false when img isn't the frame after the one last printed (ie. when seeking),
+    // so its dirty rect isn't trusted
+    void print(const Image & img, const Args & args, std::ostream & out, bool follows_previous = true);
+    void invalidate();
+
+private:
+    Image processed_;  // scaled and color adjusted, before palette reduction
+    Image displayed_;  // as printed
+    Image previous_processed_;
+    Image previous_displayed_;
+    Args::Color color_ {Args::Color::NONE};
+    Args::Disp_char disp_char_ {Args::Disp_char::HALF_BLOCK};
+    std::optional<Char_vals> char_vals_;
+    bool valid_ {false};
+};
+
+// output to stdout goes to standard_out instead
+void display_image(const Image & img, const Args & args, std::ostream & standard_out);
+void print_image(const Image_view & img, const Args & args, std::ostream & out);
+int get_display_cols(const Image_view & img, const Args & args);
+
+// load the char ramp for args' font, and the palette lookup tables, ahead of their first use.
+// Starts no threads, so processes forked afterwards get them already loaded
+void preload_display(const Args & args);
 
 #endif // DISPLAY_HPP
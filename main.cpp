@@ -1,59 +1,53 @@
 // Convert an image input to ascii art
+#include <exception>
 #include <iostream>
 
-#include "display.hpp"
+#include "batch.hpp"
+#include "server.hpp"
+#include "slideshow.hpp"
 #include "codecs/image.hpp"
 
-int main(int argc, char * argv[])
+namespace
 {
-    auto args = parse_args(argc, argv);
-    if(!args)
-        return EXIT_FAILURE;
-
-    try
+    int run(int argc, char * argv[])
     {
-        auto img = get_image_data(*args);
+        auto args = parse_args(argc, argv);
+        if(!args)
+            return EXIT_FAILURE;
 
-        if(args->get_image_count)
-        {
-            std::cout<<img->num_images()<<'\n';
-            return 0;
-        }
+        if(args->connect_socket)
+            return run_client(*args->connect_socket, argc, argv);
 
-        if(args->get_frame_count)
-        {
-            std::cout<<img->num_frames()<<'\n';
-            return 0;
-        }
+        if(args->serve_socket)
+            return run_server(*args, run);
 
-        if(!img->supports_multiple_images() && args->image_no > 0)
-            throw std::runtime_error{args->help_text + "\nImage type doesn't support multiple images"};
+        Image::set_memory_limit(args->memory_limit);
 
-        if(!img->supports_animation() && args->animate)
-            throw std::runtime_error{args->help_text + "\nImage type doesn't support animation"};
+        if(args->slideshow)
+            return run_slideshow(*args);
 
-        if(args->display)
-            display_image(*img, *args);
+        if(!std::empty(args->batch_inputs))
+            return process_batch(*args);
 
-        if(args->convert_filename)
+        try
         {
-            if(args->frame_no)
-                img->get_frame(*args->frame_no).convert(*args);
-            else if(args->image_no)
-                img->get_image(*args->image_no).convert(*args);
-            else
-                img->convert(*args);
+            process_input(*args, std::cout);
         }
-    }
-    catch(Early_exit & e)
-    {
+        catch(Early_exit & e)
+        {
+            return EXIT_SUCCESS;
+        }
+        catch(const std::exception & e)
+        {
+            std::cerr<<e.what()<<'\n';
+            return EXIT_FAILURE;
+        }
+
         return EXIT_SUCCESS;
     }
-    catch(const std::runtime_error & e)
-    {
-        std::cerr<<e.what()<<'\n';
-        return EXIT_FAILURE;
-    }
+}
 
-    return EXIT_SUCCESS;
+int main(int argc, char * argv[])
+{
+    return run(argc, argv);
 }
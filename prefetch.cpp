@@ -0,0 +1,346 @@
+#include "prefetch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include <cerrno>
+#include <cstdint>
+
+#include "config.h"
+#include "thread_pool.hpp"
+
+#ifdef HAS_UNISTD
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(HAS_IO_URING) && defined(HAS_MMAN) && defined(HAS_UNISTD)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace
+{
+    // only this much of each input is read ahead, so huge inputs don't push everything else out of the page cache
+    constexpr std::size_t max_readahead_size = 64u * 1024u * 1024u;
+
+#ifdef HAS_UNISTD
+    struct File
+    {
+        int fd {-1};
+        File() = default;
+        explicit File(int fd): fd{fd} {}
+        ~File() { if(fd >= 0) close(fd); }
+        File(const File &) = delete;
+        File & operator=(const File &) = delete;
+        File(File && other): fd{std::exchange(other.fd, -1)} {}
+        File & operator=(File && other) { std::swap(fd, other.fd); return *this; }
+        operator int() const { return fd; }
+    };
+
+    // open path, and get how much of it to read ahead. Returns a closed File if it shouldn't be read ahead
+    File open_input(const std::string & path, std::size_t & size)
+    {
+        // "-" is stdin
+        if(path == "-")
+            return File{-1};
+
+        File file{open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+        struct stat info;
+        if(file < 0 || fstat(file, &info) < 0 || !S_ISREG(info.st_mode) || info.st_size <= 0)
+            return File{-1};
+
+        size = std::min(static_cast<std::size_t>(info.st_size), max_readahead_size);
+        return file;
+    }
+
+    // start reading path into the page cache. This doesn't wait for the reads to finish
+    void read_ahead(const std::string & path)
+    {
+        std::size_t size {0};
+        if(auto file = open_input(path, size); file >= 0)
+            posix_fadvise(file, 0, static_cast<off_t>(size), POSIX_FADV_WILLNEED);
+    }
+#endif
+
+#if defined(HAS_IO_URING) && defined(HAS_MMAN) && defined(HAS_UNISTD)
+    // just enough of an io_uring to request readahead with, through the raw system calls
+    class Ring
+    {
+    public:
+        explicit Ring(unsigned entries)
+        {
+            io_uring_params params{};
+            fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+            if(fd_ < 0 || !supports(IORING_OP_FADVISE))
+                return;
+
+            entries_ = params.sq_entries;
+
+            sq_map_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_map_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            if(params.features & IORING_FEAT_SINGLE_MMAP)
+                sq_map_size_ = cq_map_size_ = std::max(sq_map_size_, cq_map_size_);
+
+            sq_map_ = mmap(nullptr, sq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+            if(sq_map_ == MAP_FAILED)
+                return;
+
+            cq_map_ = (params.features & IORING_FEAT_SINGLE_MMAP) ? sq_map_
+                : mmap(nullptr, cq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+            if(cq_map_ == MAP_FAILED)
+                return;
+
+            sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+            auto sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+            if(sqes == MAP_FAILED)
+                return;
+            sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+            auto sq = static_cast<char *>(sq_map_);
+            sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+            sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+            sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+            auto cq = static_cast<char *>(cq_map_);
+            cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+            cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+            cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+            cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        }
+
+        ~Ring()
+        {
+            if(sqes_)
+                munmap(sqes_, sqes_size_);
+            if(cq_map_ != MAP_FAILED && cq_map_ != sq_map_)
+                munmap(cq_map_, cq_map_size_);
+            if(sq_map_ != MAP_FAILED)
+                munmap(sq_map_, sq_map_size_);
+            if(fd_ >= 0)
+                close(fd_);
+        }
+
+        Ring(const Ring &) = delete;
+        Ring & operator=(const Ring &) = delete;
+
+        bool is_open() const { return sqes_; }
+        unsigned entries() const { return entries_; }
+
+        // queue a request to read the first size bytes of fd into the page cache, submitted by the next wait. No more
+        // than entries() may be queued or in flight at once
+        void queue_readahead(int fd, std::size_t size, std::uint64_t user_data)
+        {
+            auto tail = std::atomic_ref{*sq_tail_}.load(std::memory_order_relaxed);
+            auto index = tail & sq_mask_;
+
+            sqes_[index] = io_uring_sqe{};
+            sqes_[index].opcode = IORING_OP_FADVISE;
+            sqes_[index].fd = fd;
+            sqes_[index].len = static_cast<std::uint32_t>(size);
+            sqes_[index].fadvise_advice = POSIX_FADV_WILLNEED;
+            sqes_[index].user_data = user_data;
+            sq_array_[index] = index;
+
+            // the kernel must see the entry before the new tail
+            std::atomic_ref{*sq_tail_}.store(tail + 1, std::memory_order_release);
+            ++queued_;
+        }
+
+        // submit queued requests, wait for at least one to finish, then call on_complete(user_data, result) for
+        // every finished request. on_complete may queue more. Returns false if the ring stopped working
+        template <typename Func>
+        bool wait(Func on_complete)
+        {
+            // the kernel may submit only some of the queue, or none when it's short of memory or the completion
+            // queue is full, so finished reads are handled in between until all are submitted
+            do
+            {
+                auto submitted = syscall(__NR_io_uring_enter, fd_, queued_, 1u, IORING_ENTER_GETEVENTS, nullptr, 0);
+                if(submitted >= 0)
+                    queued_ -= static_cast<unsigned>(submitted);
+                else if(errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                    return false;
+
+                complete(on_complete);
+            } while(queued_ > 0);
+
+            return true;
+        }
+
+    private:
+        // whether the kernel supports op. Ops were added over several kernel versions after io_uring itself
+        bool supports(std::uint8_t op) const
+        {
+            constexpr unsigned max_ops = 256;
+            std::vector<char> buffer(sizeof(io_uring_probe) + max_ops * sizeof(io_uring_probe_op));
+            auto probe = reinterpret_cast<io_uring_probe *>(std::data(buffer));
+
+            // probing came in the same kernel version as IORING_OP_FADVISE, so kernels without it can't read ahead either
+            if(syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, max_ops) < 0)
+                return false;
+
+            return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+        }
+
+        // call on_complete for every finished request
+        template <typename Func>
+        void complete(Func & on_complete)
+        {
+            auto head = std::atomic_ref{*cq_head_}.load(std::memory_order_relaxed);
+            auto tail = std::atomic_ref{*cq_tail_}.load(std::memory_order_acquire);
+            for(; head != tail; ++head)
+            {
+                auto & cqe = cqes_[head & cq_mask_];
+                on_complete(cqe.user_data, cqe.res);
+            }
+
+            // frees the completion slots for the kernel
+            std::atomic_ref{*cq_head_}.store(head, std::memory_order_release);
+        }
+
+        int fd_ {-1};
+        unsigned entries_ {0};
+        unsigned queued_ {0};
+
+        void * sq_map_ {MAP_FAILED};
+        void * cq_map_ {MAP_FAILED};
+        std::size_t sq_map_size_ {0};
+        std::size_t cq_map_size_ {0};
+        io_uring_sqe * sqes_ {nullptr};
+        std::size_t sqes_size_ {0};
+
+        unsigned * sq_tail_ {nullptr};
+        unsigned sq_mask_ {0};
+        unsigned * sq_array_ {nullptr};
+        unsigned * cq_head_ {nullptr};
+        unsigned * cq_tail_ {nullptr};
+        unsigned cq_mask_ {0};
+        io_uring_cqe * cqes_ {nullptr};
+    };
+#endif
+}
+
+Input_prefetcher::Input_prefetcher(const std::vector<std::string> & paths, std::size_t depth):
+    paths_{paths},
+    depth_{std::max<std::size_t>(depth, 1u)}
+{
+#ifdef HAS_UNISTD
+    reader_ = std::thread{&Input_prefetcher::run, this};
+#endif
+}
+
+Input_prefetcher::~Input_prefetcher()
+{
+    {
+        std::lock_guard lock{mutex_};
+        stop_ = true;
+    }
+    window_cv_.notify_all();
+
+    if(reader_.joinable())
+        reader_.join();
+}
+
+void Input_prefetcher::take(std::size_t i)
+{
+    {
+        std::lock_guard lock{mutex_};
+        if(i + 1 <= taken_end_)
+            return;
+        taken_end_ = i + 1;
+    }
+    window_cv_.notify_all();
+}
+
+void Input_prefetcher::run()
+{
+    if(!run_io_uring())
+        run_threads();
+}
+
+bool Input_prefetcher::run_io_uring()
+{
+#if defined(HAS_IO_URING) && defined(HAS_MMAN) && defined(HAS_UNISTD)
+    Ring ring{static_cast<unsigned>(std::min<std::size_t>(depth_, 256u))};
+    if(!ring.is_open())
+        return false;
+
+    // files stay open until their request finishes
+    std::vector<File> files(std::size(paths_));
+    std::size_t in_flight = 0;
+    std::size_t next = 0;
+
+    while(true)
+    {
+        {
+            std::unique_lock lock{mutex_};
+            if(in_flight == 0)
+                window_cv_.wait(lock, [&]{ return stop_ || next == std::size(paths_) || in_window(next); });
+            if(stop_ || next == std::size(paths_))
+            {
+                if(in_flight == 0)
+                    break;
+            }
+        }
+
+        // request everything in the window, as far as the ring has room
+        while(in_flight < ring.entries() && next < std::size(paths_))
+        {
+            {
+                std::lock_guard lock{mutex_};
+                if(stop_ || !in_window(next))
+                    break;
+            }
+
+            auto i = next++;
+            std::size_t size {0};
+            files[i] = open_input(paths_[i], size);
+            if(files[i] < 0)
+                continue;
+
+            ring.queue_readahead(files[i], size, i);
+            ++in_flight;
+        }
+
+        if(in_flight == 0)
+            continue;
+
+        // readahead is only a hint, so failed requests are left for the input to be read as usual
+        auto ok = ring.wait([&](std::uint64_t i, int)
+        {
+            files[i] = File{-1};
+            --in_flight;
+        });
+        if(!ok)
+            return true;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Input_prefetcher::run_threads()
+{
+#ifdef HAS_UNISTD
+    // tasks are handed out in order, so each waits for its own input to come into the window
+    Thread_pool pool{depth_};
+    pool.parallel_for(std::size(paths_), [this](std::size_t i)
+    {
+        if(wait_for_window(i))
+            read_ahead(paths_[i]);
+    });
+#endif
+}
+
+bool Input_prefetcher::wait_for_window(std::size_t i)
+{
+    std::unique_lock lock{mutex_};
+    window_cv_.wait(lock, [this, i]{ return stop_ || in_window(i); });
+    return !stop_;
+}
@@ -0,0 +1,57 @@
+#ifndef PREFETCH_HPP
+#define PREFETCH_HPP
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+
+// Starts reading batch inputs into the page cache ahead of the threads decoding
+// them, so waiting on storage overlaps with decoding instead of stalling it.
+// Inputs are still opened and mapped as usual when they're decoded, so nothing
+// read ahead is copied or held by this process. Inputs are read ahead in order,
+// up to depth past the furthest one taken. Readahead is requested through
+// io_uring where the kernel supports it, and otherwise through a Thread_pool of
+// depth threads
+class Input_prefetcher
+{
+public:
+    // starts reading paths ahead in the background
+    Input_prefetcher(const std::vector<std::string> & paths, std::size_t depth);
+    // stops reading ahead, and waits for requests in progress
+    ~Input_prefetcher();
+    Input_prefetcher(const Input_prefetcher &) = delete;
+    Input_prefetcher & operator=(const Input_prefetcher &) = delete;
+    Input_prefetcher(Input_prefetcher &&) = delete;
+    Input_prefetcher & operator=(Input_prefetcher &&) = delete;
+
+    // paths[i] is about to be opened, so reading ahead can move on past it
+    void take(std::size_t i);
+
+private:
+    // reads paths_ ahead until they're all done, or stop_ is set
+    void run();
+    // returns false if io_uring isn't available, before reading anything ahead
+    bool run_io_uring();
+    void run_threads();
+
+    // whether paths_[i] is close enough to the inputs taken to read ahead yet
+    bool in_window(std::size_t i) const { return i < taken_end_ + depth_; }
+    // wait until in_window(i). Returns false if stopped first
+    bool wait_for_window(std::size_t i);
+
+    std::vector<std::string> paths_;
+    std::size_t depth_;
+
+    std::mutex mutex_;
+    std::condition_variable window_cv_; // signalled when taken_end_ moves, or stop_ is set
+    std::size_t taken_end_ {0}; // one past the furthest input taken
+    bool stop_ {false};
+
+    std::thread reader_;
+};
+
+#endif // PREFETCH_HPP
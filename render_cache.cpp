@@ -0,0 +1,442 @@
+#include "render_cache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include <cctype>
+#include <cerrno>
+#include <ctime>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "config.h"
+#include "codecs/binio.hpp"
+#include "codecs/pixel_cache.hpp"
+
+#if defined(HAS_DIRENT) && defined(HAS_UNISTD)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef HAS_SENDFILE
+#include <sys/sendfile.h>
+#endif
+
+namespace
+{
+    // changes whenever the same key would render differently
+    constexpr auto format_version = 2;
+
+    // decoded images taking more than this share of the cache would evict too much else to be worth storing
+    constexpr auto max_pixels_share = 8u;
+
+    // entry names are the key hash, as this many hex digits
+    constexpr auto entry_name_size = 16u;
+
+    // entries are written under this prefix, then renamed. Any older than temp_max_age were left by a writer that died
+    constexpr auto temp_prefix = std::string_view{".tmp-"};
+    constexpr std::time_t temp_max_age = 10 * 60;
+
+    // SipHash-2-4 with 128-bit output, as specified by Aumasson and Bernstein. Keys and entry names are stored on
+    // disk, so unlike std::hash, this has to give the same result on every platform and standard library
+    class Sip_hash
+    {
+    public:
+        using Digest = std::array<std::uint64_t, 2>;
+
+        static Digest hash(std::span<const unsigned char> data)
+        {
+            // a fixed key, since this only has to tell inputs apart, not resist someone picking them
+            constexpr std::uint64_t k0 = 0x0706050403020100ull, k1 = 0x0F0E0D0C0B0A0908ull;
+            Sip_hash h{k0 ^ 0x736F6D6570736575ull, k1 ^ 0x646F72616E646F6Dull ^ 0xEEu, k0 ^ 0x6C7967656E657261ull, k1 ^ 0x7465646279746573ull};
+
+            auto words = std::size(data) / 8u;
+            for(std::size_t i = 0; i < words; ++i)
+                h.compress(load(std::data(data) + 8u * i, 8u));
+            h.compress(load(std::data(data) + 8u * words, std::size(data) % 8u) | static_cast<std::uint64_t>(std::size(data)) << 56u);
+
+            h.v2_ ^= 0xEEu;
+            h.rounds(4);
+            auto low = h.v0_ ^ h.v1_ ^ h.v2_ ^ h.v3_;
+            h.v1_ ^= 0xDDu;
+            h.rounds(4);
+            return {low, h.v0_ ^ h.v1_ ^ h.v2_ ^ h.v3_};
+        }
+
+        static Digest hash(const std::string & data)
+        {
+            return hash({reinterpret_cast<const unsigned char *>(std::data(data)), std::size(data)});
+        }
+
+    private:
+        Sip_hash(std::uint64_t v0, std::uint64_t v1, std::uint64_t v2, std::uint64_t v3): v0_{v0}, v1_{v1}, v2_{v2}, v3_{v3} {}
+
+        // little-endian, for up to 8 bytes
+        static std::uint64_t load(const unsigned char * data, std::size_t size)
+        {
+            std::uint64_t word{0};
+            std::memcpy(&word, data, size);
+            if constexpr(std::endian::native == std::endian::big)
+                word = bswap(word);
+            return word;
+        }
+
+        void compress(std::uint64_t m)
+        {
+            v3_ ^= m;
+            rounds(2);
+            v0_ ^= m;
+        }
+
+        void rounds(int count)
+        {
+            for(auto i = 0; i < count; ++i)
+            {
+                v0_ += v1_; v1_ = std::rotl(v1_, 13); v1_ ^= v0_; v0_ = std::rotl(v0_, 32);
+                v2_ += v3_; v3_ = std::rotl(v3_, 16); v3_ ^= v2_;
+                v0_ += v3_; v3_ = std::rotl(v3_, 21); v3_ ^= v0_;
+                v2_ += v1_; v1_ = std::rotl(v1_, 17); v1_ ^= v2_; v2_ = std::rotl(v2_, 32);
+            }
+        }
+
+        std::uint64_t v0_, v1_, v2_, v3_;
+    };
+
+#if defined(HAS_DIRENT) && defined(HAS_UNISTD)
+    struct File
+    {
+        int fd {-1};
+        explicit File(int fd): fd{fd} {}
+        ~File() { if(fd >= 0) close(fd); }
+        File(const File &) = delete;
+        File & operator=(const File &) = delete;
+        operator int() const { return fd; }
+    };
+
+    bool write_all(int fd, const char * data, std::size_t size)
+    {
+        while(size > 0)
+        {
+            auto written = ::write(fd, data, size);
+            if(written < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+                return false;
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+        return true;
+    }
+
+    // copy size bytes of in, starting from offset, to out
+    void copy_to_fd(int in, off_t offset, std::size_t size, int out)
+    {
+    #ifdef HAS_SENDFILE
+        while(size > 0)
+        {
+            auto sent = sendfile(out, in, &offset, size);
+            if(sent < 0 && errno == EINTR)
+                continue;
+            if(sent <= 0)
+                break; // fall back to copying what's left
+            size -= static_cast<std::size_t>(sent);
+        }
+    #endif
+
+        std::array<char, 65536> buffer;
+        while(size > 0)
+        {
+            auto read = pread(in, std::data(buffer), std::min(size, std::size(buffer)), offset);
+            if(read < 0 && errno == EINTR)
+                continue;
+            if(read <= 0 || !write_all(out, std::data(buffer), static_cast<std::size_t>(read)))
+                throw std::runtime_error{"Error writing cached output: " + std::string{std::strerror(errno)}};
+            offset += read;
+            size -= static_cast<std::size_t>(read);
+        }
+    }
+
+    bool is_entry_name(std::string_view name)
+    {
+        return std::size(name) == entry_name_size && std::all_of(std::begin(name), std::end(name), [](char c) { return std::isxdigit(static_cast<unsigned char>(c)); });
+    }
+#endif
+}
+
+Render_cache::Render_cache(const std::string & dir, std::size_t max_size):
+    dir_{dir},
+    max_size_{max_size}
+{
+#if defined(HAS_DIRENT) && defined(HAS_UNISTD)
+    if(mkdir(dir_.c_str(), 0777) < 0 && errno != EEXIST)
+        throw std::runtime_error{"Could not create cache directory (" + dir_ + ") : " + std::string{std::strerror(errno)}};
+#endif
+}
+
+Render_cache & Render_cache::get(const Args & args)
+{
+    static Render_cache cache{*args.cache_dir, args.cache_size};
+    return cache;
+}
+
+bool Render_cache::can_cache(const Args & args)
+{
+    return args.cache_dir && args.display && !args.animate && !args.convert_filename && !args.get_image_count && !args.get_frame_count;
+}
+
+bool Render_cache::can_cache_pixels(const Args & args)
+{
+    return args.cache_dir && args.display && !args.convert_filename && !args.get_image_count && !args.get_frame_count;
+}
+
+std::string Render_cache::pixels_key(std::span<const unsigned char> input, const Args & args)
+{
+    std::ostringstream key;
+    auto input_hash = Sip_hash::hash(input);
+    key<<"v"<<format_version<<" input:"<<std::hex<<std::setfill('0')<<std::setw(16)<<input_hash[1]<<std::setw(16)<<input_hash[0]<<std::dec<<':'<<std::size(input);
+
+    // the extension picks the format of inputs without a signature
+    if(auto pos = args.input_filename.find_last_of("./\\"); args.input_filename != "-" && pos != std::string::npos && args.input_filename[pos] == '.')
+    {
+        auto extension = args.input_filename.substr(pos);
+        for(auto && i: extension)
+            i = std::tolower(i);
+        key<<" ext:"<<extension;
+    }
+
+    key<<" format:"<<static_cast<int>(args.force_file);
+    if(args.image_no)
+        key<<" image:"<<*args.image_no;
+    if(args.frame_no)
+        key<<" frame:"<<*args.frame_no;
+    if(args.animate)
+        key<<" animate";
+    if(args.memory_limit)
+        key<<" memory:"<<*args.memory_limit;
+    for(auto && arg: args.extra_args)
+        key<<" arg:"<<std::size(arg)<<':'<<arg;
+
+    return std::move(key).str();
+}
+
+std::string Render_cache::key(const std::string & pixels_key, const Args & args)
+{
+    std::ostringstream key;
+
+    // without --cols, the width is set by the terminal
+    key<<pixels_key<<" rows:"<<args.rows.value_or(0)<<" cols:"<<(args.cols ? *args.cols : get_screen_cols())
+       <<" bg:"<<static_cast<int>(args.bg)<<" invert:"<<args.invert
+       <<" color:"<<static_cast<int>(args.color)<<" char:"<<static_cast<int>(args.disp_char);
+
+    if(args.disp_char == Args::Disp_char::ASCII)
+        key<<" font:"<<args.font_name<<':'<<args.font_size;
+
+    return std::move(key).str();
+}
+
+std::string Render_cache::entry_path(const std::string & key) const
+{
+    std::array<char, entry_name_size + 1> name;
+    std::snprintf(std::data(name), std::size(name), "%016llx", static_cast<unsigned long long>(Sip_hash::hash(key)[0]));
+    return dir_ + '/' + std::data(name);
+}
+
+bool Render_cache::output(const std::string & key, const Args & args, std::ostream & standard_out)
+{
+#if defined(HAS_DIRENT) && defined(HAS_UNISTD)
+    File entry{open(entry_path(key).c_str(), O_RDONLY | O_CLOEXEC)};
+    if(entry < 0)
+        return false;
+
+    // entries start with their full key, in case of a hash collision
+    struct stat info;
+    auto header = key + '\n';
+    std::string stored_header(std::size(header), '\0');
+    if(fstat(entry, &info) < 0
+            || pread(entry, std::data(stored_header), std::size(stored_header), 0) != static_cast<ssize_t>(std::size(stored_header))
+            || stored_header != header)
+        return false;
+
+    futimens(entry, nullptr); // mark as recently used
+
+    auto offset = static_cast<off_t>(std::size(header));
+    auto size = static_cast<std::size_t>(info.st_size - offset);
+
+    if(args.output_filename != "-")
+    {
+        File output_file{open(args.output_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666)};
+        if(output_file < 0)
+            throw std::runtime_error{"Could not open output file (" + args.output_filename + ") : " + std::string{std::strerror(errno)}};
+        copy_to_fd(entry, offset, size, output_file);
+    }
+    else if(standard_out.rdbuf() == std::cout.rdbuf())
+    {
+        std::cout.flush();
+        std::fflush(stdout);
+        copy_to_fd(entry, offset, size, STDOUT_FILENO);
+    }
+    else
+    {
+        std::string rendered(size, '\0');
+        if(pread(entry, std::data(rendered), size, offset) != static_cast<ssize_t>(size))
+            return false;
+        standard_out.write(std::data(rendered), static_cast<std::streamsize>(size));
+    }
+
+    return true;
+#else
+    // supress unused parameter warnings
+    (void)key, (void)args, (void)standard_out;
+    return false;
+#endif
+}
+
+void Render_cache::store(const std::string & key, std::string_view rendered)
+{
+    // entries start with their full key, in case of a hash collision
+    add_entry(key, [&key, rendered](std::ostream & out)
+    {
+        out<<key<<'\n'<<rendered;
+    });
+}
+
+std::unique_ptr<Input_source> Render_cache::open_pixels(const std::string & key)
+{
+    auto source = std::make_unique<Input_source>(entry_path(key));
+    if(!source->is_open() || Pixel_cache::read_key(source->contents()) != key)
+        return {};
+
+#if defined(HAS_DIRENT) && defined(HAS_UNISTD)
+    utimensat(AT_FDCWD, entry_path(key).c_str(), nullptr, 0); // mark as recently used
+#endif
+    return source;
+}
+
+void Render_cache::store_pixels(const std::string & key, const Image & img, const Args & args)
+{
+    if(Pixel_cache::file_size(img, args, key) > max_size_ / max_pixels_share)
+        return;
+
+    add_entry(key, [&](std::ostream & out)
+    {
+        Pixel_cache::write(out, img, args, key);
+    });
+}
+
+void Render_cache::add_entry(const std::string & key, const std::function<void(std::ostream &)> & write_entry)
+{
+#if defined(HAS_DIRENT) && defined(HAS_UNISTD)
+    // written under a temporary name, then renamed into place, so readers never see a partial entry
+    auto temp_path = dir_ + '/' + std::string{temp_prefix} + "XXXXXX";
+    if(File temp{mkstemp(std::data(temp_path))}; temp < 0)
+        return;
+
+    std::size_t size {0};
+    try
+    {
+        std::ofstream out{temp_path, std::ios_base::binary};
+        write_entry(out);
+        size = static_cast<std::size_t>(out.tellp());
+        out.close();
+        if(!out || std::rename(temp_path.c_str(), entry_path(key).c_str()) != 0)
+            throw std::runtime_error{"Error writing cache entry"};
+    }
+    catch(const std::exception &)
+    {
+        unlink(temp_path.c_str());
+        return;
+    }
+
+    std::lock_guard lock{mutex_};
+    if(total_size_)
+        *total_size_ += size;
+
+    // the first entry added checks the size of everything already there
+    if(!total_size_ || *total_size_ > max_size_)
+        evict();
+#else
+    // supress unused parameter warnings
+    (void)key, (void)write_entry;
+#endif
+}
+
+void Render_cache::evict()
+{
+#if defined(HAS_DIRENT) && defined(HAS_UNISTD)
+    auto dir = opendir(dir_.c_str());
+    if(!dir)
+        return;
+
+    std::vector<std::tuple<std::time_t, std::size_t, std::string>> entries; // last used, size, path
+    std::size_t total_size {0};
+    const auto now = std::time(nullptr);
+    while(auto dir_entry = readdir(dir))
+    {
+        auto is_temp = std::string_view{dir_entry->d_name}.starts_with(temp_prefix);
+        if(!is_temp && !is_entry_name(dir_entry->d_name))
+            continue;
+
+        auto path = dir_ + '/' + dir_entry->d_name;
+        struct stat info;
+        if(stat(path.c_str(), &info) < 0 || !S_ISREG(info.st_mode))
+            continue;
+
+        // temporary files are still being written, unless they're old enough to have been abandoned
+        if(is_temp)
+        {
+            if(now - info.st_mtime > temp_max_age)
+                unlink(path.c_str());
+            continue;
+        }
+
+        entries.emplace_back(info.st_mtime, info.st_size, std::move(path));
+        total_size += info.st_size;
+    }
+    closedir(dir);
+
+    // evicting down to less than the limit leaves room for a while before looking through the directory again
+    if(total_size > max_size_)
+    {
+        std::sort(std::begin(entries), std::end(entries));
+
+        const auto target_size = max_size_ / 4 * 3;
+        for(auto && [time, size, path]: entries)
+        {
+            if(total_size <= target_size)
+                break;
+            if(unlink(path.c_str()) == 0 || errno == ENOENT)
+                total_size -= size;
+        }
+    }
+
+    total_size_ = total_size;
+#endif
+}
+
+void Render_cache::write(std::string_view rendered, const Args & args, std::ostream & standard_out)
+{
+    std::ofstream output_file;
+    if(args.output_filename != "-")
+        output_file.open(args.output_filename);
+    std::ostream & out = args.output_filename == "-" ? standard_out : output_file;
+
+    if(!out)
+        throw std::runtime_error{"Could not open output file " + (args.output_filename == "-" ? "" : ("(" + args.output_filename + ") ")) + ": " + std::string{std::strerror(errno)}};
+
+    out.write(std::data(rendered), static_cast<std::streamsize>(std::size(rendered)));
+}
@@ -0,0 +1,72 @@
+#ifndef RENDER_CACHE_HPP
+#define RENDER_CACHE_HPP
+
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <cstddef>
+
+#include "args.hpp"
+#include "codecs/image.hpp"
+
+// Display output kept on disk in args.cache_dir, so rendering the same input the same way again skips decoding
+// it. Entries are keyed by a hash of the input and the args that change what's rendered. Images that are slow to
+// decode are also kept decoded, as Pixel_cache files, so they can be shown at other sizes without decoding them.
+// Once the entries outgrow args.cache_size, the least recently used are removed. Writes are atomic, so several
+// processes can share a directory. Shared by all threads
+class Render_cache
+{
+public:
+    // the cache for args.cache_dir, which is created if needed
+    static Render_cache & get(const Args & args);
+
+    // whether display output for args can be cached. Animations, and anything else that needs the decoded image, can't
+    static bool can_cache(const Args & args);
+
+    // whether the decoded images args display can be cached. Unlike display output, this includes animations
+    static bool can_cache_pixels(const Args & args);
+
+    // identifies the images args would display from input, as decoded
+    static std::string pixels_key(std::span<const unsigned char> input, const Args & args);
+    // identifies the output of rendering those images with args
+    static std::string key(const std::string & pixels_key, const Args & args);
+
+    // if there's an entry for key, write it where display_image would, and return true.
+    // Entries are copied by the kernel to output files and to stdout when standard_out is std::cout
+    bool output(const std::string & key, const Args & args, std::ostream & standard_out);
+
+    // add rendered as the entry for key. Failing to write it isn't an error, it's just not cached
+    void store(const std::string & key, std::string_view rendered);
+
+    // the decoded images stored for key, as a Pixel_cache file to open with get_image_data. Null if there's no entry
+    std::unique_ptr<Input_source> open_pixels(const std::string & key);
+    // add the images of img that args display as the entry for key, unless they'd take up too much of the cache.
+    // As with store, failures are ignored
+    void store_pixels(const std::string & key, const Image & img, const Args & args);
+
+    // write rendered output where display_image would
+    static void write(std::string_view rendered, const Args & args, std::ostream & standard_out);
+
+private:
+    Render_cache(const std::string & dir, std::size_t max_size);
+
+    std::string entry_path(const std::string & key) const;
+    // write an entry under a temporary name, then move it into place
+    void add_entry(const std::string & key, const std::function<void(std::ostream &)> & write_entry);
+    // remove the least recently used entries until they fit well under max_size_, and any abandoned temporary files
+    void evict();
+
+    std::string dir_;
+    std::size_t max_size_;
+
+    std::mutex mutex_;
+    std::optional<std::size_t> total_size_; // of entries, as of the last look through dir_, plus those stored since
+};
+
+#endif // RENDER_CACHE_HPP
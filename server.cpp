@@ -0,0 +1,497 @@
+#include "server.hpp"
+
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "config.h"
+#include "display.hpp"
+
+#if defined(HAS_SOCKET) && defined(HAS_SIGNAL) && defined(HAS_UNISTD)
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+/* Protocol
+*
+* The client connects, then sends:
+*     size: native uint32_t, with the client's stdin, stdout, and stderr attached as SCM_RIGHTS
+*     payload: size bytes of NUL-terminated strings:
+*         working directory
+*         value of COLUMNS (empty if unset)
+*         argv[0] .. argv[argc - 1], without --connect
+*
+* While waiting, the client may send any number of:
+*     signal: native int32_t, a signal the client received, to be raised in the request
+*
+* When the request finishes, the server sends:
+*     exit code: native int32_t
+*
+* The server closing the connection without an exit code means the request was killed
+*/
+
+#if defined(HAS_SOCKET) && defined(HAS_SIGNAL) && defined(HAS_UNISTD)
+namespace
+{
+    constexpr auto num_std_fds = 3;
+    constexpr std::uint32_t max_request_size = 64u * 1024u * 1024u;
+
+    std::string error_str(const std::string & msg)
+    {
+        return msg + ": " + std::strerror(errno);
+    }
+
+    sockaddr_un get_address(const std::string & socket_path)
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if(std::size(socket_path) >= sizeof(address.sun_path))
+            throw std::runtime_error{"Socket path too long: " + socket_path};
+        std::memcpy(address.sun_path, std::data(socket_path), std::size(socket_path));
+        return address;
+    }
+
+    // returns false when the connection closes before size bytes are read
+    bool read_all(int fd, void * data, std::size_t size)
+    {
+        auto pos = static_cast<char *>(data);
+        while(size > 0)
+        {
+            auto received = recv(fd, pos, size, 0);
+            if(received == 0)
+                return false;
+            if(received < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+                return false;
+            }
+            pos += received;
+            size -= static_cast<std::size_t>(received);
+        }
+        return true;
+    }
+
+    void write_all(int fd, const void * data, std::size_t size)
+    {
+        auto pos = static_cast<const char *>(data);
+        while(size > 0)
+        {
+            auto sent = send(fd, pos, size, MSG_NOSIGNAL);
+            if(sent < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+                throw std::runtime_error{error_str("Error sending to socket")};
+            }
+            pos += sent;
+            size -= static_cast<std::size_t>(sent);
+        }
+    }
+
+    int connect_to(const std::string & socket_path)
+    {
+        auto address = get_address(socket_path);
+        auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0)
+            throw std::runtime_error{error_str("Could not create socket")};
+
+        if(connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0)
+        {
+            auto error = error_str("Could not connect to server at " + socket_path);
+            close(fd);
+            throw std::runtime_error{error};
+        }
+        return fd;
+    }
+
+    int listen_on(const std::string & socket_path)
+    {
+        auto address = get_address(socket_path);
+        auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0)
+            throw std::runtime_error{error_str("Could not create socket")};
+
+        // only this user may connect
+        auto old_mask = umask(S_IRWXG | S_IRWXO);
+        auto bound = bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+        if(!bound && errno == EADDRINUSE)
+        {
+            // left over from a server that didn't shut down cleanly, unless something is still answering on it
+            if(auto other = socket(AF_UNIX, SOCK_STREAM, 0); other >= 0)
+            {
+                auto in_use = connect(other, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+                close(other);
+                if(!in_use)
+                {
+                    unlink(std::data(socket_path));
+                    bound = bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+                }
+                else
+                {
+                    errno = EADDRINUSE;
+                }
+            }
+        }
+        umask(old_mask);
+
+        if(!bound || listen(fd, SOMAXCONN) < 0)
+        {
+            auto error = error_str("Could not listen on " + socket_path);
+            close(fd);
+            throw std::runtime_error{error};
+        }
+        return fd;
+    }
+
+    volatile sig_atomic_t stop_flag = 0;
+    void handle_stop(int) { stop_flag = 1; }
+
+    // the client passes these on to the request, rather than leaving it running after the client is gone
+    constexpr int forwarded_signals[] = {SIGINT, SIGTERM, SIGHUP, SIGQUIT};
+
+    volatile sig_atomic_t client_connection = -1;
+    volatile sig_atomic_t last_forwarded_signal = 0;
+    void forward_signal(int sig)
+    {
+        auto saved_errno = errno;
+        last_forwarded_signal = sig;
+        std::int32_t msg = sig;
+        send(client_connection, &msg, sizeof(msg), MSG_NOSIGNAL);
+        errno = saved_errno;
+    }
+
+    // set without SA_RESTART, so that blocking calls return when interrupted
+    void set_signal(int sig, void(*handler)(int))
+    {
+        struct sigaction action{};
+        action.sa_handler = handler;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = 0;
+        if(sigaction(sig, &action, nullptr) < 0)
+            throw std::runtime_error{error_str("Could not set signal handler")};
+    }
+
+    // runs in the forked process. Sets up the client's environment, then hands argv to handle_request
+    int serve_request(int connection, Request_handler handle_request)
+    {
+        std::uint32_t size {0};
+        iovec iov{&size, sizeof(size)};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * num_std_fds)];
+
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        auto received = recvmsg(connection, &msg, 0);
+        if(received <= 0)
+            throw std::runtime_error{"Error reading request: connection closed"};
+
+        auto cmsg = CMSG_FIRSTHDR(&msg);
+        if((msg.msg_flags & MSG_CTRUNC) || !cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+                || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * num_std_fds))
+            throw std::runtime_error{"Error reading request: standard streams not received"};
+
+        int fds[num_std_fds];
+        std::memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+        if(static_cast<std::size_t>(received) < sizeof(size)
+                && !read_all(connection, reinterpret_cast<char *>(&size) + received, sizeof(size) - static_cast<std::size_t>(received)))
+            throw std::runtime_error{"Error reading request: connection closed"};
+
+        if(size > max_request_size)
+            throw std::runtime_error{"Error reading request: too large"};
+
+        std::string payload(size, '\0');
+        if(!read_all(connection, std::data(payload), size))
+            throw std::runtime_error{"Error reading request: connection closed"};
+
+        // move the received fds clear of 0 - 2 first, in case the server was started with some of those closed
+        for(auto && fd: fds)
+        {
+            auto moved = fcntl(fd, F_DUPFD_CLOEXEC, num_std_fds);
+            if(moved < 0)
+                throw std::runtime_error{error_str("Error reading request")};
+            close(fd);
+            fd = moved;
+        }
+        for(auto i = 0; i < num_std_fds; ++i)
+        {
+            if(dup2(fds[i], i) < 0)
+                throw std::runtime_error{error_str("Error reading request")};
+            close(fds[i]);
+        }
+
+        // from here, errors are reported to the client
+        std::vector<char *> argv;
+        std::vector<std::string_view> fields;
+        for(std::size_t pos = 0; pos < std::size(payload);)
+        {
+            auto end = payload.find('\0', pos);
+            if(end == std::string::npos)
+                break;
+            fields.emplace_back(std::data(payload) + pos, end - pos);
+            argv.push_back(std::data(payload) + pos);
+            pos = end + 1;
+        }
+
+        if(std::size(fields) < 3)
+        {
+            std::cerr<<"Error reading request: missing fields\n";
+            return EXIT_FAILURE;
+        }
+
+        if(chdir(std::data(fields[0])) < 0)
+        {
+            std::cerr<<error_str("Could not change to directory " + std::string{fields[0]})<<'\n';
+            return EXIT_FAILURE;
+        }
+
+        if(std::empty(fields[1]))
+            unsetenv("COLUMNS");
+        else
+            setenv("COLUMNS", std::data(fields[1]), 1);
+
+        argv.erase(std::begin(argv), std::begin(argv) + 2);
+        argv.push_back(nullptr);
+
+        // raise signals from the client here, or SIGTERM if the client goes away first. Signals are blocked in
+        // this thread, so they're handled by the one running the request
+        std::atomic<bool> finished {false};
+        sigset_t all_signals, old_signals;
+        sigfillset(&all_signals);
+        pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+        std::thread watcher{[connection, &finished]
+        {
+            std::int32_t sig;
+            while(read_all(connection, &sig, sizeof(sig)))
+            {
+                for(auto && forwarded: forwarded_signals)
+                {
+                    if(sig == forwarded)
+                        kill(getpid(), sig);
+                }
+            }
+            if(!finished)
+                kill(getpid(), SIGTERM);
+        }};
+        pthread_sigmask(SIG_SETMASK, &old_signals, nullptr);
+
+        std::int32_t exit_code = handle_request(static_cast<int>(std::size(argv)) - 1, std::data(argv));
+
+        std::cout.flush();
+        std::cerr.flush();
+        std::fflush(nullptr);
+
+        finished = true;
+        write_all(connection, &exit_code, sizeof(exit_code));
+        shutdown(connection, SHUT_RDWR);
+        watcher.join();
+
+        return exit_code;
+    }
+}
+#endif
+
+int run_server(const Args & args, Request_handler handle_request)
+{
+#if defined(HAS_SOCKET) && defined(HAS_SIGNAL) && defined(HAS_UNISTD)
+    int listener {-1};
+    try
+    {
+        preload_display(args);
+
+        listener = listen_on(*args.serve_socket);
+
+        set_signal(SIGINT,  handle_stop);
+        set_signal(SIGTERM, handle_stop);
+        set_signal(SIGHUP,  handle_stop);
+        signal(SIGCHLD, SIG_IGN); // request processes are never waited on
+
+        while(!stop_flag)
+        {
+            auto connection = accept(listener, nullptr, nullptr);
+            if(connection < 0)
+            {
+                if(errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                throw std::runtime_error{error_str("Error accepting connection")};
+            }
+
+            auto pid = fork();
+            if(pid == 0)
+            {
+                close(listener);
+                for(auto && sig: {SIGINT, SIGTERM, SIGHUP, SIGCHLD})
+                    signal(sig, SIG_DFL);
+
+                auto exit_code = EXIT_FAILURE;
+                try
+                {
+                    exit_code = serve_request(connection, handle_request);
+                }
+                catch(const std::exception & e)
+                {
+                    std::cerr<<e.what()<<'\n';
+                }
+                std::exit(exit_code);
+            }
+
+            if(pid < 0)
+                std::cerr<<error_str("Could not start process for request")<<'\n';
+
+            close(connection);
+        }
+    }
+    catch(const std::runtime_error & e)
+    {
+        std::cerr<<e.what()<<'\n';
+        if(listener >= 0)
+        {
+            close(listener);
+            unlink(std::data(*args.serve_socket));
+        }
+        return EXIT_FAILURE;
+    }
+
+    close(listener);
+    unlink(std::data(*args.serve_socket));
+    return EXIT_SUCCESS;
+#else
+    // supress unused parameter warnings
+    (void)args, (void)handle_request;
+    std::cerr<<"Server mode is not supported on this platform\n";
+    return EXIT_FAILURE;
+#endif
+}
+
+int run_client(const std::string & socket_path, int argc, char * argv[])
+{
+#if defined(HAS_SOCKET) && defined(HAS_SIGNAL) && defined(HAS_UNISTD)
+    int connection {-1};
+    try
+    {
+        std::string payload;
+
+        std::vector<char> cwd(256);
+        while(!getcwd(std::data(cwd), std::size(cwd)))
+        {
+            if(errno != ERANGE)
+                throw std::runtime_error{error_str("Could not get working directory")};
+            cwd.resize(std::size(cwd) * 2);
+        }
+        payload += std::data(cwd);
+        payload += '\0';
+
+        if(auto columns = std::getenv("COLUMNS"); columns)
+            payload += columns;
+        payload += '\0';
+
+        for(int i = 0; i < argc; ++i)
+        {
+            auto arg = std::string_view{argv[i]};
+            if(arg == "--")
+            {
+                for(; i < argc; ++i)
+                {
+                    payload += argv[i];
+                    payload += '\0';
+                }
+                break;
+            }
+            if(arg == "--connect")
+            {
+                ++i;
+                continue;
+            }
+            if(arg.starts_with("--connect="))
+                continue;
+
+            payload += arg;
+            payload += '\0';
+        }
+
+        if(std::size(payload) > max_request_size)
+            throw std::runtime_error{"Request too large"};
+
+        connection = connect_to(socket_path);
+
+        auto size = static_cast<std::uint32_t>(std::size(payload));
+        iovec iov{&size, sizeof(size)};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * num_std_fds)] {};
+
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        auto cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * num_std_fds);
+        constexpr int std_fds[num_std_fds] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+        std::memcpy(CMSG_DATA(cmsg), std_fds, sizeof(std_fds));
+
+        ssize_t sent;
+        while((sent = sendmsg(connection, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR);
+        if(sent < 0)
+            throw std::runtime_error{error_str("Error sending request")};
+        write_all(connection, reinterpret_cast<const char *>(&size) + sent, sizeof(size) - static_cast<std::size_t>(sent));
+        write_all(connection, std::data(payload), std::size(payload));
+
+        client_connection = connection;
+        for(auto && sig: forwarded_signals)
+            set_signal(sig, forward_signal);
+
+        std::int32_t exit_code;
+        auto finished = read_all(connection, &exit_code, sizeof(exit_code));
+
+        for(auto && sig: forwarded_signals)
+            signal(sig, SIG_DFL);
+        close(connection);
+
+        if(finished)
+            return exit_code;
+
+        // the request was killed, most likely by a signal passed on from here. Exit the same way
+        if(last_forwarded_signal)
+            raise(last_forwarded_signal);
+
+        std::cerr<<"Server closed the connection before the request finished\n";
+        return EXIT_FAILURE;
+    }
+    catch(const std::runtime_error & e)
+    {
+        if(connection >= 0)
+            close(connection);
+        std::cerr<<e.what()<<'\n';
+        return EXIT_FAILURE;
+    }
+#else
+    // supress unused parameter warnings
+    (void)socket_path, (void)argc, (void)argv;
+    std::cerr<<"Server mode is not supported on this platform\n";
+    return EXIT_FAILURE;
+#endif
+}
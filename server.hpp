@@ -0,0 +1,20 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <string>
+
+#include "args.hpp"
+
+// handles one invocation, parsing argc / argv as if they came from the command line. Returns the exit code
+using Request_handler = int (*)(int argc, char * argv[]);
+
+// listen on a Unix domain socket at args.serve_socket until interrupted. Each request is handled in a process
+// forked from this one, so the fonts and tables loaded here up front are already warm. The request runs in the
+// client's working directory, with its COLUMNS and stdin / stdout / stderr. Returns the exit code
+int run_server(const Args & args, Request_handler handle_request);
+
+// send this invocation (argv, without --connect) to the server listening at socket_path, and wait for it to
+// finish. Signals that would stop the client are passed on to the request. Returns the request's exit code
+int run_client(const std::string & socket_path, int argc, char * argv[]);
+
+#endif // SERVER_HPP
@@ -0,0 +1,194 @@
+#include "slideshow.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <cstdlib>
+
+#include "animate.hpp"
+#include "display.hpp"
+#include "codecs/image.hpp"
+
+namespace
+{
+    // slides rendered ahead on each side of the one shown
+    constexpr std::size_t prerender_distance = 1u;
+
+    // Renders slides on a thread of its own, for the slide shown first, then its
+    // neighbours. Rendering itself still splits each image across the display
+    // thread pool, which only one thread may use at a time, so slides are
+    // rendered one after another
+    class Slide_renderer
+    {
+    public:
+        explicit Slide_renderer(const Args & args):
+            args_{args},
+            screen_size_{get_screen_size()},
+            thread_{&Slide_renderer::run, this}
+        {}
+
+        ~Slide_renderer()
+        {
+            {
+                std::lock_guard lock{mutex_};
+                stop_ = true;
+            }
+            work_cv_.notify_one();
+            thread_.join();
+        }
+
+        Slide_renderer(const Slide_renderer &) = delete;
+        Slide_renderer & operator=(const Slide_renderer &) = delete;
+        Slide_renderer(Slide_renderer &&) = delete;
+        Slide_renderer & operator=(Slide_renderer &&) = delete;
+
+        // slide i, rendered to fit the terminal, or null if it isn't ready yet. Doesn't wait, so the slideshow can
+        // handle keys meanwhile. Also makes i the slide rendered next if it isn't ready, followed by its neighbours
+        Animate::Slide get(std::size_t i)
+        {
+            std::lock_guard lock{mutex_};
+
+            // everything rendered before a resize is the wrong size
+            if(auto size = get_screen_size(); size != screen_size_)
+            {
+                screen_size_ = size;
+                slides_.clear();
+                work_cv_.notify_one();
+            }
+
+            if(current_ != i)
+            {
+                current_ = i;
+                std::erase_if(slides_, [this](auto && slide) { return distance(slide.first) > prerender_distance; });
+                work_cv_.notify_one();
+            }
+
+            auto slide = slides_.find(i);
+            return slide != std::end(slides_) ? slide->second : nullptr;
+        }
+
+    private:
+        using Screen_size = std::pair<int, int>;
+        static Screen_size get_screen_size() { return {get_screen_cols(), get_screen_rows()}; }
+
+        // steps from current_ to i, in whichever direction is shorter, as slides wrap around
+        std::size_t distance(std::size_t i) const
+        {
+            auto num_slides = std::size(args_.batch_inputs);
+            auto forward = (i + num_slides - current_) % num_slides;
+            return std::min(forward, num_slides - forward);
+        }
+
+        // the next slide to render: current_, then the ones after and before it, nearest first
+        std::optional<std::size_t> next_job() const
+        {
+            auto num_slides = std::size(args_.batch_inputs);
+            for(std::size_t d = 0; d <= prerender_distance && d <= num_slides / 2; ++d)
+            {
+                for(auto i: {(current_ + d) % num_slides, (current_ + num_slides - d % num_slides) % num_slides})
+                {
+                    if(!slides_.contains(i))
+                        return i;
+                }
+            }
+            return std::nullopt;
+        }
+
+        void run()
+        {
+            std::unique_lock lock{mutex_};
+            while(true)
+            {
+                std::optional<std::size_t> job;
+                work_cv_.wait(lock, [this, &job]{ return stop_ || (job = next_job()); });
+                if(stop_)
+                    return;
+
+                auto size = screen_size_;
+                lock.unlock();
+                auto slide = render(*job, size);
+                lock.lock();
+
+                // dropped if the terminal was resized, or the slideshow moved on, while it was rendering
+                if(size == screen_size_ && distance(*job) <= prerender_distance)
+                    slides_[*job] = std::move(slide);
+            }
+        }
+
+        Animate::Slide render(std::size_t i, Screen_size size) const
+        {
+            auto [screen_cols, screen_rows] = size;
+            const auto & input = args_.batch_inputs[i];
+
+            auto slide_args = args_;
+            slide_args.input_filename = input;
+            slide_args.batch_inputs.clear();
+
+            std::ostringstream out;
+            try
+            {
+                auto img = get_image_data(slide_args);
+                Image_view view = slide_args.frame_no ? img->get_frame(*slide_args.frame_no) : img->get_image(slide_args.image_no.value_or(0u));
+
+                // fit the whole image on screen, above the status line. Like a normal display, it's not scaled up
+                if(!slide_args.cols && !slide_args.rows && view.get_width() > 0 && view.get_height() > 0)
+                {
+                    auto rows = static_cast<std::size_t>(std::max(1, screen_rows - 1));
+                    auto cols = std::min({static_cast<std::size_t>(std::max(1, screen_cols)), view.get_width(), rows * 2u * view.get_width() / view.get_height()});
+                    slide_args.cols = static_cast<int>(std::max<std::size_t>(1u, cols));
+                }
+
+                print_image(view, slide_args, out);
+            }
+            // codecs exit early once they've done all that was asked, without an image to show
+            catch(Early_exit &)
+            {}
+            catch(const std::exception & e)
+            {
+                out<<e.what()<<'\n';
+            }
+
+            out<<input<<" ("<<i + 1<<'/'<<std::size(args_.batch_inputs)<<')';
+            return std::make_shared<const std::string>(std::move(out).str());
+        }
+
+        Args args_;
+
+        std::mutex mutex_;
+        std::condition_variable work_cv_; // signalled when current_ or screen_size_ changes, or stop_ is set
+        std::map<std::size_t, Animate::Slide> slides_;
+        std::size_t current_ {0};
+        Screen_size screen_size_;
+        bool stop_ {false};
+
+        std::thread thread_; // last, so everything it uses is set up first
+    };
+}
+
+int run_slideshow(const Args & args)
+{
+    try
+    {
+        Slide_renderer renderer{args};
+
+        auto animator = Animate{args};
+        animator.slideshow(std::size(args.batch_inputs), [&renderer](std::size_t i) { return renderer.get(i); },
+            std::chrono::duration<float>{args.slideshow_interval});
+    }
+    catch(const std::exception & e)
+    {
+        std::cerr<<e.what()<<'\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
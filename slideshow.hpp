@@ -0,0 +1,12 @@
+#ifndef SLIDESHOW_HPP
+#define SLIDESHOW_HPP
+
+#include "args.hpp"
+
+// show each of args.batch_inputs full screen, one at a time, with keyboard
+// controls to move between them. While one is shown, the images either side
+// of it are decoded and rendered in the background, so moving to them is
+// immediate. Returns the exit code
+int run_slideshow(const Args & args);
+
+#endif // SLIDESHOW_HPP
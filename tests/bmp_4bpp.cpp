@@ -0,0 +1,116 @@
+// Reading 4 bit per pixel BMPs, where each byte packs 2 pixels. Odd width rows
+// end with half a byte, which must not be written past the end of the row
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "../args.hpp"
+#include "../codecs/bmp.hpp"
+
+namespace
+{
+    void write_u16(std::string & out, std::uint16_t value)
+    {
+        for(auto i = 0; i < 2; ++i)
+            out += static_cast<char>(value >> (8 * i));
+    }
+    void write_u32(std::string & out, std::uint32_t value)
+    {
+        for(auto i = 0; i < 4; ++i)
+            out += static_cast<char>(value >> (8 * i));
+    }
+
+    Color palette_color(std::size_t index)
+    {
+        return Color{static_cast<unsigned char>(index * 16), static_cast<unsigned char>(255 - index * 16), static_cast<unsigned char>(index)};
+    }
+
+    // bottom to top, uncompressed, with a 16 color palette. Pixel (row, col) is index (row * width + col) % 16
+    std::string make_bmp(std::size_t width, std::size_t height)
+    {
+        constexpr std::size_t header_size = 14 + 40 + 16 * 4;
+        const auto row_size = (4 * width + 31) / 32 * 4;
+
+        std::string bmp = "BM";
+        write_u32(bmp, header_size + row_size * height);
+        write_u32(bmp, 0);
+        write_u32(bmp, header_size);
+
+        write_u32(bmp, 40);
+        write_u32(bmp, width);
+        write_u32(bmp, height);
+        write_u16(bmp, 1);  // planes
+        write_u16(bmp, 4);  // bpp
+        write_u32(bmp, 0);  // BI_RGB
+        write_u32(bmp, 0);  // image size
+        write_u32(bmp, 0);  // x pixels per meter
+        write_u32(bmp, 0);  // y pixels per meter
+        write_u32(bmp, 16); // palette size
+        write_u32(bmp, 0);  // important colors
+
+        for(std::size_t i = 0; i < 16; ++i)
+        {
+            auto c = palette_color(i);
+            bmp += {static_cast<char>(c.b), static_cast<char>(c.g), static_cast<char>(c.r), 0};
+        }
+
+        for(std::size_t row = height; row-- > 0;)
+        {
+            std::string packed(row_size, '\0');
+            for(std::size_t col = 0; col < width; ++col)
+            {
+                auto index = (row * width + col) % 16;
+                packed[col / 2] |= static_cast<char>(col % 2 == 0 ? index << 4 : index);
+            }
+            bmp += packed;
+        }
+
+        return bmp;
+    }
+
+    bool test_width(std::size_t width)
+    {
+        constexpr std::size_t height = 3;
+        std::istringstream input{make_bmp(width, height)};
+
+        Bmp img;
+        img.open(input, Args{});
+
+        if(img.get_width() != width || img.get_height() != height)
+        {
+            std::cerr<<"FAILED: width "<<width<<": read as "<<img.get_width()<<'x'<<img.get_height()<<'\n';
+            return false;
+        }
+
+        for(std::size_t row = 0; row < height; ++row)
+        {
+            if(std::size(img[row]) != width)
+            {
+                std::cerr<<"FAILED: width "<<width<<": row "<<row<<" has "<<std::size(img[row])<<" pixels\n";
+                return false;
+            }
+            for(std::size_t col = 0; col < width; ++col)
+            {
+                if(img[row][col] != palette_color((row * width + col) % 16))
+                {
+                    std::cerr<<"FAILED: width "<<width<<": wrong color at "<<row<<','<<col<<'\n';
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+}
+
+int main()
+{
+    auto ok = true;
+    for(std::size_t width: {1, 2, 5, 8, 31})
+        ok &= test_width(width);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,153 @@
+// Spilling animation frames to file under a memory limit, for frames composed
+// from the previous frame the way GIF frames are, sharing their unchanged rows
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <set>
+
+#include <cstdlib>
+
+#include "../codecs/image.hpp"
+
+namespace
+{
+    constexpr std::size_t width = 64, height = 64;
+    constexpr std::size_t frame_size = width * height * sizeof(Color);
+    constexpr std::size_t frame_count = 16;
+
+    // frames composed as in Gif::open: each frame redraws some rows of the canvas, and copies it
+    class Composed: public Image
+    {
+    public:
+        template <typename Redraw>
+        explicit Composed(Redraw redraw, std::size_t frames = frame_count)
+        {
+            set_size(width, height);
+            for(std::size_t f = 0; f < frames; ++f)
+            {
+                for(std::size_t row = 0; row < height; ++row)
+                {
+                    if(redraw(f, row))
+                        image_data_[row].assign(width, Color{static_cast<unsigned char>(f), static_cast<unsigned char>(row), static_cast<unsigned char>(f >> 8)});
+                }
+                images_.emplace_back().copy_image_data(*this);
+                use_stored_image(std::size(images_) - 1);
+            }
+            image_data_.clear();
+            this_is_first_image_ = false;
+        }
+
+        // bytes of pixel rows held in memory by any frame, counting shared rows once
+        std::size_t resident_size() const
+        {
+            std::set<const void *> rows;
+            for(auto & frame: images_)
+            {
+                if(!frame.is_resident())
+                    continue;
+                for(std::size_t row = 0; row < height; ++row)
+                    rows.insert(&frame[row]);
+            }
+            return std::size(rows) * width * sizeof(Color);
+        }
+
+        // check each frame still has the pixels it was composed with
+        bool frames_match(const Composed & other) const
+        {
+            for(std::size_t f = 0; f < frame_count; ++f)
+            {
+                auto & frame = get_frame(f);
+                auto & other_frame = other.get_frame(f);
+                frame.make_resident();
+                other_frame.make_resident();
+                for(std::size_t row = 0; row < height; ++row)
+                {
+                    if(frame[row] != other_frame[row])
+                        return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    bool check(bool cond, const char * what)
+    {
+        if(!cond)
+            std::cerr<<"FAILED: "<<what<<'\n';
+        return cond;
+    }
+
+    template <typename Redraw>
+    bool test_spill(const char * name, Redraw redraw, std::size_t limit)
+    {
+        std::cout<<name<<'\n';
+
+        Image::set_memory_limit(std::nullopt);
+        auto unlimited = Composed{redraw};
+        auto unlimited_size = unlimited.resident_size();
+
+        Image::set_memory_limit(limit);
+        auto limited = Composed{redraw};
+        auto decoded_size = limited.resident_size();
+
+        // play through twice, reading spilled frames back in
+        for(auto pass = 0; pass < 2; ++pass)
+        {
+            for(std::size_t f = 0; f < frame_count; ++f)
+                limited.get_frame(f).make_resident();
+        }
+        auto played_size = limited.resident_size();
+
+        std::cout<<"  resident bytes: "<<unlimited_size<<" unlimited, "<<decoded_size<<" decoded with a "<<limit<<" byte limit, "<<played_size<<" after playing\n";
+
+        Image::set_memory_limit(std::nullopt);
+        auto ok = check(decoded_size <= unlimited_size, "spilling increased resident size while decoding");
+        ok &= check(played_size <= unlimited_size, "spilling increased resident size while playing");
+        ok &= check(played_size < unlimited_size, "spilling didn't reduce resident size");
+        ok &= check(played_size <= limit, "resident size is over the limit after playing");
+        ok &= check(limited.frames_match(unlimited), "spilled frames changed");
+        return ok;
+    }
+
+    // a long animation under a small limit, which has to track use in time linear in the number of frames
+    template <typename Redraw>
+    bool test_many_frames(const char * name, Redraw redraw)
+    {
+        constexpr std::size_t many_frames = 5000;
+        constexpr std::size_t limit = 4 * frame_size;
+        constexpr auto max_time = std::chrono::seconds{10};
+        std::cout<<name<<'\n';
+
+        Image::set_memory_limit(limit);
+        auto start = std::chrono::steady_clock::now();
+
+        auto frames = Composed{redraw, many_frames};
+        for(std::size_t f = 0; f < many_frames; ++f)
+            frames.get_frame(f).make_resident();
+
+        auto time = std::chrono::duration<float>{std::chrono::steady_clock::now() - start};
+        auto size = frames.resident_size();
+        std::cout<<"  "<<many_frames<<" frames decoded and played in "<<time.count()<<"s, "<<size<<" resident bytes\n";
+
+        Image::set_memory_limit(std::nullopt);
+        auto ok = check(time < max_time, "tracking frames against the memory limit is too slow");
+        ok &= check(size <= limit, "resident size is over the limit after playing");
+        return ok;
+    }
+}
+
+int main()
+{
+    auto ok = true;
+
+    // most rows change every frame, so frames own most of their rows, and spilling them frees memory
+    ok &= test_spill("redrawn frames", [](std::size_t f, std::size_t row) { return row % 4 != f % 4; }, 3 * frame_size);
+
+    // one row changes per frame, so most rows are shared by many frames, and are only freed once they're all spilled
+    ok &= test_spill("mostly shared frames", [](std::size_t f, std::size_t row) { return f == 0 || row == f; }, frame_size);
+
+    ok &= test_many_frames("many redrawn frames", [](std::size_t f, std::size_t row) { return f == 0 || row % 2 == f % 2; });
+    ok &= test_many_frames("many mostly shared frames", [](std::size_t f, std::size_t row) { return f == 0 || row == f % height; });
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
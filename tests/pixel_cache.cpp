@@ -0,0 +1,128 @@
+// Writing decoded images to the pixel cache and reading them back. Indexed
+// frames are stored as indexes, and frames sharing data are stored once
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cstdlib>
+
+#include "../args.hpp"
+#include "../codecs/pixel_cache.hpp"
+
+namespace
+{
+    constexpr std::size_t width = 64, height = 48;
+
+    // an animation of indexed frames, where frame f is drawn from pattern patterns[f]
+    class Indexed_animation: public Image
+    {
+    public:
+        explicit Indexed_animation(const std::vector<std::size_t> & patterns)
+        {
+            std::vector<Color> palette;
+            for(std::size_t i = 0; i < 16; ++i)
+                palette.emplace_back(static_cast<unsigned char>(i * 16), static_cast<unsigned char>(255 - i * 16), static_cast<unsigned char>(i));
+
+            for(auto pattern: patterns)
+            {
+                auto & frame = images_.emplace_back();
+                frame.set_size(width, height, palette);
+                for(std::size_t row = 0; row < height; ++row)
+                {
+                    for(std::size_t col = 0; col < width; ++col)
+                        frame.index_row(row)[col] = static_cast<std::uint8_t>((row * pattern + col) % std::size(palette));
+                }
+                frame_delays_.emplace_back(0.1f * static_cast<float>(std::size(frame_delays_) + 1));
+            }
+
+            move_image_data(images_.front());
+            images_.erase(std::begin(images_));
+            deduplicate_frames(true);
+        }
+
+        bool supports_animation() const override { return true; }
+    };
+
+    // a still image, with a different color at each pixel
+    Image make_still()
+    {
+        Image img{width, height};
+        for(std::size_t row = 0; row < height; ++row)
+        {
+            for(std::size_t col = 0; col < width; ++col)
+                img[row][col] = Color{static_cast<unsigned char>(row * 4), static_cast<unsigned char>(col * 4), static_cast<unsigned char>(row ^ col)};
+        }
+        return img;
+    }
+
+    bool check(bool cond, const char * what)
+    {
+        if(!cond)
+            std::cerr<<"FAILED: "<<what<<'\n';
+        return cond;
+    }
+
+    bool frames_match(const Image & a, const Image & b)
+    {
+        if(a.num_frames() != b.num_frames())
+            return false;
+
+        for(std::size_t f = 0; f < a.num_frames(); ++f)
+        {
+            auto & frame_a = a.get_frame(f);
+            auto & frame_b = b.get_frame(f);
+            frame_a.make_resident();
+            frame_b.make_resident();
+            if(frame_a.get_width() != frame_b.get_width() || frame_a.get_height() != frame_b.get_height())
+                return false;
+            if(a.num_frames() > 1 && a.get_frame_delay(f) != b.get_frame_delay(f))
+                return false;
+            for(std::size_t row = 0; row < frame_a.get_height(); ++row)
+            {
+                if(frame_a[row] != frame_b[row])
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // write img as args would display it, and read it back
+    bool test_round_trip(const char * name, const Image & img, const Args & args, std::size_t max_size)
+    {
+        std::cout<<name<<'\n';
+
+        std::ostringstream out;
+        Pixel_cache::write(out, img, args, "key");
+        auto data = out.str();
+        std::cout<<"  "<<std::size(data)<<" bytes written\n";
+
+        auto ok = check(std::size(data) == Pixel_cache::file_size(img, args, "key"), "file_size doesn't match what's written");
+        ok &= check(std::size(data) <= max_size, "written file is too large");
+        ok &= check(Pixel_cache::read_key({reinterpret_cast<const unsigned char *>(std::data(data)), std::size(data)}) == "key", "key not read back");
+
+        std::istringstream in{data};
+        Pixel_cache cached;
+        cached.open(in, args);
+        ok &= check(cached.get_frame(0).is_indexed() == img.get_frame(0).is_indexed(), "indexed frames not read back as indexes");
+        ok &= check(frames_match(img, cached), "frames read back differ");
+        return ok;
+    }
+}
+
+int main()
+{
+    auto ok = true;
+
+    Args still_args;
+    still_args.cols = width;
+    ok &= test_round_trip("still image", make_still(), still_args, width * height * sizeof(Color) * 3 / 2);
+
+    // frames 1 and 3 are the same, so are written once. Indexes take a quarter of the space of RGBA, and there are no smaller levels
+    Args anim_args;
+    anim_args.cols = width;
+    anim_args.animate = true;
+    ok &= test_round_trip("indexed animation", Indexed_animation{{1, 2, 3, 2}}, anim_args, 3 * width * height + 4 * 2048);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
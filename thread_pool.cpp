@@ -0,0 +1,97 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+Thread_pool::Thread_pool(std::size_t num_threads)
+{
+    if(num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    workers_.reserve(num_threads - 1);
+    for(std::size_t i = 1; i < num_threads; ++i)
+        workers_.emplace_back(&Thread_pool::worker, this);
+}
+
+Thread_pool::~Thread_pool()
+{
+    {
+        std::lock_guard lock{mutex_};
+        stop_ = true;
+    }
+    start_cv_.notify_all();
+
+    for(auto && t: workers_)
+        t.join();
+}
+
+void Thread_pool::parallel_for(std::size_t count, const std::function<void(std::size_t)> & task)
+{
+    if(count == 0)
+        return;
+
+    if(std::empty(workers_) || count == 1)
+    {
+        for(std::size_t i = 0; i < count; ++i)
+            task(i);
+        return;
+    }
+
+    {
+        std::lock_guard lock{mutex_};
+        task_ = &task;
+        count_ = count;
+        next_ = 0;
+        active_workers_ = std::size(workers_);
+        ++generation_;
+    }
+    start_cv_.notify_all();
+
+    run_tasks();
+
+    std::unique_lock lock{mutex_};
+    done_cv_.wait(lock, [this]{ return active_workers_ == 0; });
+    task_ = nullptr;
+
+    if(error_)
+        std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+void Thread_pool::worker()
+{
+    std::size_t generation = 0;
+    while(true)
+    {
+        {
+            std::unique_lock lock{mutex_};
+            start_cv_.wait(lock, [this, generation]{ return stop_ || generation_ != generation; });
+            if(stop_)
+                return;
+            generation = generation_;
+        }
+
+        run_tasks();
+
+        std::lock_guard lock{mutex_};
+        if(--active_workers_ == 0)
+            done_cv_.notify_one();
+    }
+}
+
+void Thread_pool::run_tasks()
+{
+    for(auto i = next_++; i < count_; i = next_++)
+    {
+        try
+        {
+            (*task_)(i);
+        }
+        catch(...)
+        {
+            std::lock_guard lock{mutex_};
+            if(!error_)
+                error_ = std::current_exception();
+            next_ = count_;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+
+// Fixed set of worker threads, for splitting the work on one image.
+// parallel_for hands out task indexes in increasing order, so a task may wait
+// on the progress of any lower-numbered task without deadlocking. Only one
+// parallel_for may run at a time, and tasks can't start more
+class Thread_pool
+{
+public:
+    // 0 uses one thread per hardware thread
+    explicit Thread_pool(std::size_t num_threads = 0);
+    ~Thread_pool();
+    Thread_pool(const Thread_pool &) = delete;
+    Thread_pool & operator=(const Thread_pool &) = delete;
+    Thread_pool(Thread_pool &&) = delete;
+    Thread_pool & operator=(Thread_pool &&) = delete;
+
+    // number of threads that run tasks, including the caller of parallel_for
+    std::size_t size() const { return std::size(workers_) + 1; }
+
+    // run task(i) for each i in [0, count), and wait for all of them to finish. The calling thread runs tasks too.
+    // If a task throws, tasks not yet started are skipped, and the first exception is rethrown
+    void parallel_for(std::size_t count, const std::function<void(std::size_t)> & task);
+
+private:
+    void worker();
+    void run_tasks();
+
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    bool stop_ {false};
+    std::size_t generation_ {0}; // incremented for each parallel_for, to wake the workers
+    std::size_t active_workers_ {0};
+    std::exception_ptr error_;
+
+    const std::function<void(std::size_t)> * task_ {nullptr};
+    std::size_t count_ {0};
+    std::atomic<std::size_t> next_ {0};
+};
+
+#endif // THREAD_POOL_HPP